@@ -0,0 +1,36 @@
+# Converts a SPIR-V binary into a C source file that defines it as a uint32_t array, so the
+# shaders can be linked into the executable instead of being read from disk at startup.
+#
+# Usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.c> -DSYMBOL=<identifier> -P embed_spirv.cmake
+#
+# Defines `const uint32_t <SYMBOL>[]` and `const size_t <SYMBOL>_size` (in bytes).
+
+file(READ "${INPUT}" HEX_CONTENTS HEX)
+string(LENGTH "${HEX_CONTENTS}" HEX_LENGTH)
+math(EXPR WORD_REMAINDER "${HEX_LENGTH} % 8")
+
+if(HEX_LENGTH EQUAL 0 OR NOT WORD_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a whole number of SPIR-V words")
+endif()
+
+# glslc writes little-endian words; reassemble each group of four bytes into a word literal so
+# the array holds the right values regardless of the host byte order.
+string(REGEX REPLACE "(..)(..)(..)(..)" "    0x\\4\\3\\2\\1u,\n" WORDS "${HEX_CONTENTS}")
+
+if(NOT WORDS MATCHES "^    0x07230203u,")
+    message(FATAL_ERROR "${INPUT} does not start with the SPIR-V magic number")
+endif()
+
+get_filename_component(INPUT_NAME "${INPUT}" NAME)
+
+file(WRITE "${OUTPUT}"
+    "/* Generated from ${INPUT_NAME} by embed_spirv.cmake. Do not edit. */\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "\n"
+    "const uint32_t ${SYMBOL}[] = {\n"
+    "${WORDS}"
+    "};\n"
+    "\n"
+    "const size_t ${SYMBOL}_size = sizeof(${SYMBOL});\n"
+)
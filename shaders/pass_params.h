@@ -0,0 +1,67 @@
+#ifndef PASS_PARAMS_H
+#define PASS_PARAMS_H
+
+/* Per-dispatch state of pathtracer.comp. This header is included by the C sources and, through
+ * GL_GOOGLE_include_directive, by the kernel, so both sides declare Pass_Params from the one field
+ * list below and cannot drift apart.
+ *
+ * The block reaches the kernel either as push constants or from a slot of a uniform buffer, both
+ * with the C struct's layout: every scalar is 32 bits and comes before the vec4s, and there are a
+ * multiple of four of them, so std140, std430 and C agree. It must stay within the 128 bytes of
+ * push constants every device supports.
+ *
+ * frame_index    Index of the frame in the run.
+ * seed           Base seed of the random sequence, mixed into every pixel's.
+ * sample_offset  Samples per pixel the frame has taken before this dispatch.
+ * slice_y        First row of the slice; gl_GlobalInvocationID.y counts from it.
+ * tile_*         The part of the output the image holds: its origin, and its extent, which is
+ *                smaller than the image for tiles at the right and bottom edges.
+ * output_*       Size of the whole output. Pixel coordinates and uv are relative to it.
+ * camera_*       Camera_Basis in camera.h: the ray through uv points along
+ *                forward + (2u - 1) * right + (1 - 2v) * up.
+ */
+#define PASS_PARAMS_FIELDS(UINT, VEC4)                                                             \
+    UINT(frame_index)                                                                              \
+    UINT(seed)                                                                                     \
+    UINT(sample_offset)                                                                            \
+    UINT(slice_y)                                                                                  \
+    UINT(tile_x)                                                                                   \
+    UINT(tile_y)                                                                                   \
+    UINT(tile_width)                                                                               \
+    UINT(tile_height)                                                                              \
+    UINT(output_width)                                                                             \
+    UINT(output_height)                                                                            \
+    UINT(reserved0)                                                                                \
+    UINT(reserved1)                                                                                \
+    VEC4(camera_origin)                                                                            \
+    VEC4(camera_forward)                                                                           \
+    VEC4(camera_right)                                                                             \
+    VEC4(camera_up)
+
+/* glslang defines VULKAN when compiling for Vulkan. */
+#ifdef VULKAN
+
+#define PASS_PARAMS_UINT(name) uint name;
+#define PASS_PARAMS_VEC4(name) vec4 name;
+
+struct Pass_Params {
+    PASS_PARAMS_FIELDS(PASS_PARAMS_UINT, PASS_PARAMS_VEC4)
+};
+
+#else
+
+#include <stdint.h>
+
+#define PASS_PARAMS_UINT(name) uint32_t name;
+#define PASS_PARAMS_VEC4(name) float name[4];
+
+typedef struct Pass_Params {
+    PASS_PARAMS_FIELDS(PASS_PARAMS_UINT, PASS_PARAMS_VEC4)
+} Pass_Params;
+
+#endif
+
+#undef PASS_PARAMS_UINT
+#undef PASS_PARAMS_VEC4
+
+#endif /* PASS_PARAMS_H */
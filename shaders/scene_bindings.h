@@ -0,0 +1,28 @@
+#ifndef SCENE_BINDINGS_H
+#define SCENE_BINDINGS_H
+
+/* The scene descriptor set, shared by the C sources and the kernels. It holds every buffer, image
+ * and sampler a scene uses in three arrays, and kernels select entries by the indices
+ * add_bindless_buffer() and friends return, so binding a new scene only writes descriptors.
+ *
+ * With descriptor indexing the arrays are large, partially bound and updatable after binding, and
+ * the kernels are built with BINDLESS defined to declare them as runtime arrays. The update after
+ * bind limits are at least 500000 wherever descriptor indexing is supported, so the capacities
+ * need no checking. Otherwise the arrays have the fixed sizes below, within the minimum
+ * per-stage limits of every device.
+ */
+#define SCENE_SET 1
+
+#define SCENE_BINDING_BUFFERS 0
+#define SCENE_BINDING_IMAGES 1
+#define SCENE_BINDING_SAMPLERS 2
+
+#define BINDLESS_MAX_BUFFERS 1024
+#define BINDLESS_MAX_IMAGES 1024
+#define BINDLESS_MAX_SAMPLERS 32
+
+#define FIXED_MAX_BUFFERS 4
+#define FIXED_MAX_IMAGES 16
+#define FIXED_MAX_SAMPLERS 4
+
+#endif /* SCENE_BINDINGS_H */
@@ -0,0 +1,71 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "atomic_file.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Longest suffix create_temp_file() appends, including the terminator. */
+#define TEMP_SUFFIX_SIZE 32
+
+FILE *create_temp_file(const char *path, char **out_temp_path) {
+    assert(path);
+    assert(out_temp_path);
+
+    size_t size = strlen(path) + TEMP_SUFFIX_SIZE;
+    char *temp_path = malloc(size);
+    if (!temp_path) {
+        perror("malloc failed");
+        return NULL;
+    }
+
+#ifdef _WIN32
+    snprintf(temp_path, size, "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+    FILE *file = fopen(temp_path, "wb");
+#else
+    snprintf(temp_path, size, "%s.XXXXXX", path);
+    FILE *file = NULL;
+    int fd = mkstemp(temp_path);
+    if (fd >= 0) {
+        /* mkstemp() creates the file private to its owner; the result is as readable as before. */
+        file = fchmod(fd, 0644) == 0 ? fdopen(fd, "wb") : NULL;
+        if (!file) {
+            close(fd);
+            remove(temp_path);
+        }
+    }
+#endif
+
+    if (!file) {
+        perror(temp_path);
+        free(temp_path);
+        return NULL;
+    }
+
+    *out_temp_path = temp_path;
+    return file;
+}
+
+bool replace_file(const char *from, const char *to) {
+    assert(from);
+    assert(to);
+
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
@@ -0,0 +1,21 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Files that are rewritten whole, like the pipeline cache and the workgroup tuning, are written to
+ * a temporary file next to them and then renamed over them. Render nodes run many jobs against
+ * one such file, so each write gets a name no other process is using, and a rename only ever
+ * moves a complete file into place.
+ */
+
+/* Creates and opens a file next to `path` for writing, and returns its malloc'd name in
+ * `out_temp_path`. Returns NULL on failure.
+ */
+FILE *create_temp_file(const char *path, char **out_temp_path);
+
+/* Atomically replaces `to` with `from`. */
+bool replace_file(const char *from, const char *to);
+
+#endif /* ATOMIC_FILE_H */
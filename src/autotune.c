@@ -0,0 +1,386 @@
+#include "autotune.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "atomic_file.h"
+#include "camera.h"
+#include "device.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "readback.h"
+#include "renderer.h"
+#include "utils.h"
+
+/* Candidates are every pairing of these that fits the device's limits and has at least
+ * AUTOTUNE_MIN_INVOCATIONS invocations; smaller groups leave most SIMD lanes idle everywhere.
+ */
+static const uint32_t candidate_widths[] = {4, 8, 16, 32, 64, 128, 256};
+static const uint32_t candidate_heights[] = {1, 2, 4, 8, 16};
+#define AUTOTUNE_MIN_INVOCATIONS 16
+
+/* Slices short enough to time several per pass at the autotune size. */
+#define AUTOTUNE_SLICE_MS 2.0
+
+/* Longer lines in the tuning file are rejected rather than split. */
+#define TUNING_MAX_LINE 256
+
+/* Largest tuning file read back; far more devices than one machine has. */
+#define TUNING_MAX_FILE_SIZE (64 * 1024)
+
+static bool fits_device(const Physical_Device_Info *info, const Workgroup_Sizes *sizes) {
+    const VkPhysicalDeviceLimits *limits = &info->properties.limits;
+    return sizes->x && sizes->y && sizes->z && sizes->x <= limits->maxComputeWorkGroupSize[0] &&
+           sizes->y <= limits->maxComputeWorkGroupSize[1] &&
+           sizes->z <= limits->maxComputeWorkGroupSize[2] &&
+           (uint64_t)sizes->x * sizes->y * sizes->z <= limits->maxComputeWorkGroupInvocations;
+}
+
+/* Renders one frame, waits for it and hands it back. */
+static bool render_frame(Renderer *renderer, uint32_t frame_index) {
+    const Camera camera = default_camera();
+    if (!begin_frame(renderer, 0, 0, &camera)) {
+        fprintf(stderr, "begin_frame() failed\n");
+        return false;
+    }
+
+    for (uint32_t pass = 0; pass < renderer->info.passes; pass++) {
+        if (!submit_pass(renderer)) {
+            fprintf(stderr, "submit_pass() failed\n");
+            return false;
+        }
+    }
+
+    if (!wait_for_frame(renderer, frame_index)) {
+        fprintf(stderr, "wait_for_frame() failed\n");
+        return false;
+    }
+
+    if (!release_frame(renderer, frame_index)) {
+        fprintf(stderr, "release_frame() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Renders a warm-up frame and a timed one with `renderer`, which must have a pipeline bound. */
+static bool time_renderer(Renderer *renderer, double *out_gpu_ms_per_megapixel) {
+    if (!render_frame(renderer, 0)) {
+        return false;
+    }
+
+    double warm_gpu_ms = renderer->slice_gpu_ms;
+    uint64_t warm_rows = renderer->timed_rows;
+
+    if (!render_frame(renderer, 1)) {
+        return false;
+    }
+
+    /* Slices are measured when their slot is reused, so the last few are never timed. */
+    uint64_t rows = renderer->timed_rows - warm_rows;
+    if (rows == 0) {
+        fprintf(stderr, "No slices were timed\n");
+        return false;
+    }
+
+    double megapixels = (double)rows * renderer->info.width / 1e6;
+    *out_gpu_ms_per_megapixel = (renderer->slice_gpu_ms - warm_gpu_ms) / megapixels;
+    return true;
+}
+
+/* Times the variant of `pipeline` specialised for `sizes` with a renderer of its own; the renderer
+ * slices by the workgroup height, so it cannot be shared between candidates.
+ */
+static bool time_candidate(const Device *device, VmaAllocator allocator, const Autotune_Info *info,
+                           Pathtracing_Pipeline *pipeline, const Pack_Pipeline *pack_pipeline,
+                           const Workgroup_Sizes *sizes, double *out_gpu_ms_per_megapixel) {
+    Pathtracing_Constants constants = info->constants;
+    constants.workgroup_sizes = *sizes;
+
+    VkPipeline kernel = get_kernel_variant(device, pipeline, KERNEL_PATHTRACE, &constants);
+    if (!kernel) {
+        fprintf(stderr, "get_kernel_variant() failed\n");
+        return false;
+    }
+
+    const Renderer_Info renderer_info = {
+        .workgroup_sizes = *sizes,
+        .width = info->width,
+        .height = info->height,
+        .readback = pack_pipeline->layout,
+        .output_width = info->width,
+        .output_height = info->height,
+        .passes = info->passes,
+        .rerecord_passes = info->constants.push_params,
+        .slice_ms = AUTOTUNE_SLICE_MS,
+    };
+
+    /* Setup phases are not of interest here. */
+    Profile profile;
+    profile_init(&profile);
+
+    Renderer renderer;
+    bool timed = create_renderer(device, allocator, &renderer_info, &profile, &renderer) &&
+                 bind_renderer_pipeline(&renderer, pipeline, pack_pipeline, NULL);
+    if (timed) {
+        set_renderer_kernel(&renderer, kernel);
+        timed = time_renderer(&renderer, out_gpu_ms_per_megapixel);
+    }
+
+    /* A failed frame may have left work on the queue. */
+    if (!timed) {
+        device->fn.vkDeviceWaitIdle(device->device);
+    }
+
+    destroy_renderer(&renderer);
+    return timed;
+}
+
+bool autotune_workgroup_sizes(const Device *device, VmaAllocator allocator,
+                              const Autotune_Info *info, Workgroup_Tuning *out_tuning) {
+    assert(device);
+    assert(allocator);
+    assert(info);
+    assert(info->width && info->height && info->passes);
+    assert(out_tuning);
+
+    /* Every candidate, and the variant compiled up front, fits in the pipeline's variant cache. */
+    assert(ARRAY_LEN(candidate_widths) * ARRAY_LEN(candidate_heights) < PIPELINE_MAX_VARIANTS);
+
+    if (!device->info.compute_timestamp_valid_bits) {
+        fprintf(stderr, "Autotuning needs timestamps on the compute queue\n");
+        return false;
+    }
+
+    const Readback_Layout layout =
+        get_readback_layout(READBACK_FORMAT_RGBA8, info->width, info->height, 4);
+
+    Pack_Pipeline pack_pipeline;
+    if (!create_pack_pipeline(device, info->pack_shader, info->pipeline_cache, &layout, 1,
+                              &pack_pipeline)) {
+        fprintf(stderr, "create_pack_pipeline() failed\n");
+        return false;
+    }
+
+    /* One pipeline for the whole sweep: the workgroup size is a specialization constant, so each
+     * candidate is only another variant of the same kernel.
+     */
+    Pathtracing_Pipeline_Info pipeline_info = {
+        .shader_dir = info->shader_dir,
+        .constants = info->constants,
+        .pipeline_cache = info->pipeline_cache,
+    };
+    pipeline_info.constants.workgroup_sizes = DEFAULT_WORKGROUP_SIZES;
+
+    Pathtracing_Pipeline pipeline;
+    if (!create_pathtracing_pipeline(device, &pipeline_info, &pipeline)) {
+        fprintf(stderr, "create_pathtracing_pipeline() failed\n");
+        destroy_pathtracing_pipeline(device, &pipeline);
+        destroy_pack_pipeline(device, &pack_pipeline);
+        return false;
+    }
+
+    Workgroup_Tuning best = {0};
+    uint32_t candidate_count = 0;
+    bool tuned = true;
+
+    for (uint32_t i = 0; i < ARRAY_LEN(candidate_widths) && tuned; i++) {
+        for (uint32_t j = 0; j < ARRAY_LEN(candidate_heights) && tuned; j++) {
+            const Workgroup_Sizes sizes = {candidate_widths[i], candidate_heights[j], 1};
+            if (sizes.x * sizes.y < AUTOTUNE_MIN_INVOCATIONS ||
+                !fits_device(&device->info, &sizes)) {
+                continue;
+            }
+
+            double gpu_ms_per_megapixel;
+            tuned = time_candidate(device, allocator, info, &pipeline, &pack_pipeline, &sizes,
+                                   &gpu_ms_per_megapixel);
+            if (!tuned) {
+                fprintf(stderr, "time_candidate() failed for %ux%ux%u\n", sizes.x, sizes.y,
+                        sizes.z);
+                break;
+            }
+
+            if (info->verbose) {
+                fprintf(stderr, "Workgroup %ux%ux%u: %.4f GPU ms per megapixel pass\n", sizes.x,
+                        sizes.y, sizes.z, gpu_ms_per_megapixel);
+            }
+
+            if (!candidate_count || gpu_ms_per_megapixel < best.gpu_ms_per_megapixel) {
+                best = (Workgroup_Tuning){
+                    .workgroup_sizes = sizes,
+                    .gpu_ms_per_megapixel = gpu_ms_per_megapixel,
+                };
+            }
+
+            candidate_count++;
+        }
+    }
+
+    destroy_pathtracing_pipeline(device, &pipeline);
+    destroy_pack_pipeline(device, &pack_pipeline);
+
+    if (!tuned) {
+        return false;
+    }
+
+    if (!candidate_count) {
+        fprintf(stderr, "No workgroup size candidate fits the device\n");
+        return false;
+    }
+
+    *out_tuning = best;
+    return true;
+}
+
+/* Formats the device UUID as 32 lowercase hex digits. */
+static void format_device_uuid(const Physical_Device_Info *info,
+                               char out_uuid[VK_UUID_SIZE * 2 + 1]) {
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+        snprintf(out_uuid + 2 * i, 3, "%02x", info->device_uuid[i]);
+    }
+}
+
+/* Parses a tuning line: device UUID, driver version, workgroup sizes and GPU time. Returns false
+ * for comments, blank and malformed lines.
+ */
+static bool parse_tuning_line(const char *line, char out_uuid[VK_UUID_SIZE * 2 + 1],
+                              uint32_t *out_driver_version, Workgroup_Tuning *out_tuning) {
+    Workgroup_Sizes *sizes = &out_tuning->workgroup_sizes;
+    return line[0] != '#' &&
+           sscanf(line, "%32s %u %u %u %u %lf", out_uuid, out_driver_version, &sizes->x,
+                  &sizes->y, &sizes->z, &out_tuning->gpu_ms_per_megapixel) == 6;
+}
+
+bool load_workgroup_tuning(const Device *device, const char *path, Workgroup_Tuning *out_tuning) {
+    assert(device);
+    assert(path);
+    assert(out_tuning);
+
+    const Physical_Device_Info *info = &device->info;
+    if (!info->has_device_uuid) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char device_uuid[VK_UUID_SIZE * 2 + 1];
+    format_device_uuid(info, device_uuid);
+
+    bool found = false;
+    char line[TUNING_MAX_LINE];
+    while (!found && fgets(line, sizeof(line), file)) {
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        uint32_t driver_version;
+        Workgroup_Tuning tuning;
+        if (parse_tuning_line(line, uuid, &driver_version, &tuning) &&
+            strcmp(uuid, device_uuid) == 0 && driver_version == info->properties.driverVersion &&
+            fits_device(info, &tuning.workgroup_sizes)) {
+            *out_tuning = tuning;
+            found = true;
+        }
+    }
+
+    fclose(file);
+    return found;
+}
+
+/* Reads the lines of the tuning file that belong to other devices into a malloc'd string, empty
+ * if the file does not exist. Returns NULL on failure.
+ */
+static char *read_other_tunings(const char *path, const char *device_uuid) {
+    char *kept = malloc(TUNING_MAX_FILE_SIZE + 1);
+    if (!kept) {
+        perror("malloc failed");
+        return NULL;
+    }
+
+    kept[0] = '\0';
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return kept;
+    }
+
+    size_t kept_size = 0;
+    char line[TUNING_MAX_LINE];
+    while (fgets(line, sizeof(line), file)) {
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        uint32_t driver_version;
+        Workgroup_Tuning tuning;
+        if (!parse_tuning_line(line, uuid, &driver_version, &tuning) ||
+            strcmp(uuid, device_uuid) == 0) {
+            continue;
+        }
+
+        size_t length = strlen(line);
+        if (kept_size + length > TUNING_MAX_FILE_SIZE) {
+            break;
+        }
+
+        memcpy(kept + kept_size, line, length + 1);
+        kept_size += length;
+    }
+
+    fclose(file);
+    return kept;
+}
+
+bool save_workgroup_tuning(const Device *device, const char *path,
+                           const Workgroup_Tuning *tuning) {
+    assert(device);
+    assert(path);
+    assert(tuning);
+
+    const Physical_Device_Info *info = &device->info;
+    if (!info->has_device_uuid) {
+        fprintf(stderr, "The device has no UUID, so its tuning is not stored\n");
+        return true;
+    }
+
+    char device_uuid[VK_UUID_SIZE * 2 + 1];
+    format_device_uuid(info, device_uuid);
+
+    char *kept = read_other_tunings(path, device_uuid);
+    if (!kept) {
+        return false;
+    }
+
+    /* Other devices' tunings are lost if the file is truncated, so it is replaced whole. */
+    char *temp_path;
+    FILE *file = create_temp_file(path, &temp_path);
+    if (!file) {
+        fprintf(stderr, "create_temp_file() failed\n");
+        free(kept);
+        return false;
+    }
+
+    const Workgroup_Sizes *sizes = &tuning->workgroup_sizes;
+    bool written =
+        fputs("# device uuid, driver version, workgroup x y z, GPU ms per megapixel pass\n",
+              file) >= 0 &&
+        fputs(kept, file) >= 0 &&
+        fprintf(file, "%s %u %u %u %u %.6f\n", device_uuid, info->properties.driverVersion,
+                sizes->x, sizes->y, sizes->z, tuning->gpu_ms_per_megapixel) > 0;
+    written = fclose(file) == 0 && written;
+    free(kept);
+
+    if (!written || !replace_file(temp_path, path)) {
+        fprintf(stderr, "Failed to write workgroup tuning to %s\n", path);
+        remove(temp_path);
+        free(temp_path);
+        return false;
+    }
+
+    free(temp_path);
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "pipeline.h"
+
+/* Workgroup size used when the device has no tuning. */
+#define DEFAULT_WORKGROUP_SIZES ((Workgroup_Sizes){8, 4, 1})
+
+typedef struct Workgroup_Tuning {
+    Workgroup_Sizes workgroup_sizes;
+
+    /* GPU time of one pass over a million pixels with these sizes. */
+    double gpu_ms_per_megapixel;
+} Workgroup_Tuning;
+
+typedef struct Autotune_Info {
+    /* Passed on to create_pathtracing_pipeline(); may be NULL. */
+    const char *shader_dir;
+    VkShaderModule pack_shader;
+
+    /* Optional; every candidate is compiled through it. */
+    VkPipelineCache pipeline_cache;
+
+    /* The scene the candidates are timed on. `workgroup_sizes` is ignored. */
+    Pathtracing_Constants constants;
+
+    /* Size of the image rendered, and passes per timed frame. */
+    uint32_t width;
+    uint32_t height;
+    uint32_t passes;
+
+    /* Prints the time of every candidate. */
+    bool verbose;
+} Autotune_Info;
+
+/* Renders the scene of `info` with every workgroup size in a fixed sweep that fits the device's
+ * limits and returns the fastest. The candidates are variants of one pipeline, each timed with a
+ * renderer of its own; one frame warms it up and the next is timed with the renderer's slice
+ * timestamps, so the comparison is of GPU time alone. Fails if the compute queue cannot write
+ * timestamps.
+ */
+bool autotune_workgroup_sizes(const Device *device, VmaAllocator allocator,
+                              const Autotune_Info *info, Workgroup_Tuning *out_tuning);
+
+/* Looks up the tuning stored for this device in the file at `path`. Returns false if there is
+ * none, including when the file does not exist, the device has no UUID, the tuning was made with
+ * another driver version or no longer fits the device's limits.
+ */
+bool load_workgroup_tuning(const Device *device, const char *path, Workgroup_Tuning *out_tuning);
+
+/* Stores `tuning` for this device in the file at `path`, replacing its previous tuning and
+ * keeping those of other devices. Devices without a UUID cannot be told apart, so nothing is
+ * stored for them.
+ */
+bool save_workgroup_tuning(const Device *device, const char *path,
+                           const Workgroup_Tuning *tuning);
+
+#endif /* AUTOTUNE_H */
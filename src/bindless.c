@@ -0,0 +1,586 @@
+#include "bindless.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "host_allocator.h"
+#include "scene_bindings.h"
+#include "utils.h"
+
+/* Size of the placeholder buffer; large enough for any read of one vec4. */
+#define PLACEHOLDER_BUFFER_SIZE 16
+
+#define PLACEHOLDER_IMAGE_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+static VkDescriptorSetLayout create_set_layout(VkDevice device,
+                                               const VkAllocationCallbacks *allocation_callbacks,
+                                               const Bindless_Layout *layout) {
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        (VkDescriptorSetLayoutBinding){
+            .binding = SCENE_BINDING_BUFFERS,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = layout->buffer_capacity,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+
+        (VkDescriptorSetLayoutBinding){
+            .binding = SCENE_BINDING_IMAGES,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = layout->image_capacity,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+
+        (VkDescriptorSetLayoutBinding){
+            .binding = SCENE_BINDING_SAMPLERS,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = layout->sampler_capacity,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+
+    /* Slots no kernel reads need no descriptor, and slots pending work does not read can be
+     * written at any time, which is what lets a scene load without rerecording the passes.
+     */
+    const VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                           VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    const VkDescriptorBindingFlags binding_flags[] = {flags, flags, flags};
+
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = ARRAY_LEN(binding_flags),
+        .pBindingFlags = binding_flags,
+    };
+
+    const VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = layout->bindless ? &binding_flags_info : NULL,
+        .flags = layout->bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0,
+        .pBindings = bindings,
+        .bindingCount = ARRAY_LEN(bindings),
+    };
+
+    VkDescriptorSetLayout set_layout;
+    VkResult result =
+        vkCreateDescriptorSetLayout(device, &set_layout_info, allocation_callbacks, &set_layout);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateDescriptorSetLayout() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return set_layout;
+}
+
+bool create_bindless_layout(const Device *device, Bindless_Layout *layout) {
+    assert(device);
+    assert(layout);
+
+    /* The device enables descriptor indexing only with everything the bindless layout needs. */
+    if (device->info.features.descriptor_indexing) {
+        *layout = (Bindless_Layout){
+            .bindless = true,
+            .buffer_capacity = BINDLESS_MAX_BUFFERS,
+            .image_capacity = BINDLESS_MAX_IMAGES,
+            .sampler_capacity = BINDLESS_MAX_SAMPLERS,
+        };
+    } else {
+        *layout = (Bindless_Layout){
+            .bindless = false,
+            .buffer_capacity = FIXED_MAX_BUFFERS,
+            .image_capacity = FIXED_MAX_IMAGES,
+            .sampler_capacity = FIXED_MAX_SAMPLERS,
+        };
+    }
+
+    layout->set_layout = create_set_layout(
+        device->device,
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_DESCRIPTOR), layout);
+    if (!layout->set_layout) {
+        fprintf(stderr, "create_set_layout() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+void destroy_bindless_layout(const Device *device, Bindless_Layout *layout) {
+    vkDestroyDescriptorSetLayout(
+        device->device, layout->set_layout,
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_DESCRIPTOR));
+}
+
+static VkDescriptorPool create_pool(VkDevice device,
+                                    const VkAllocationCallbacks *allocation_callbacks,
+                                    const Bindless_Layout *layout) {
+    const VkDescriptorPoolSize pool_sizes[] = {
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = layout->buffer_capacity,
+        },
+
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = layout->image_capacity,
+        },
+
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = layout->sampler_capacity,
+        },
+    };
+
+    const VkDescriptorPoolCreateInfo descriptor_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = layout->bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0,
+        .maxSets = 1,
+        .pPoolSizes = pool_sizes,
+        .poolSizeCount = ARRAY_LEN(pool_sizes),
+    };
+
+    VkDescriptorPool pool;
+    VkResult result =
+        vkCreateDescriptorPool(device, &descriptor_pool_info, allocation_callbacks, &pool);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateDescriptorPool() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return pool;
+}
+
+static VkDescriptorSet allocate_set(VkDevice device, VkDescriptorPool pool,
+                                    VkDescriptorSetLayout set_layout) {
+    const VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &set_layout,
+    };
+
+    VkDescriptorSet set;
+    VkResult result = vkAllocateDescriptorSets(device, &alloc_info, &set);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkAllocateDescriptorSets failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return set;
+}
+
+static VkBuffer create_placeholder_buffer(VmaAllocator allocator, VmaAllocation *allocation) {
+    const VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = PLACEHOLDER_BUFFER_SIZE,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    };
+
+    VkBuffer buffer;
+    VkResult result =
+        vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer, allocation, NULL);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateBuffer() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return buffer;
+}
+
+static VkImage create_placeholder_image(VmaAllocator allocator, VmaAllocation *allocation) {
+    const VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = PLACEHOLDER_IMAGE_FORMAT,
+        .extent =
+            (VkExtent3D){
+                .width = 1,
+                .height = 1,
+                .depth = 1,
+            },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    };
+
+    VkImage image;
+    VkResult result = vmaCreateImage(allocator, &image_info, &alloc_info, &image, allocation, NULL);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateImage() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return image;
+}
+
+static const VkImageSubresourceRange color_subresource_range = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+static VkImageView create_placeholder_view(VkDevice device,
+                                           const VkAllocationCallbacks *allocation_callbacks,
+                                           VkImage image) {
+    const VkImageViewCreateInfo image_view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = PLACEHOLDER_IMAGE_FORMAT,
+        .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .subresourceRange = color_subresource_range,
+    };
+
+    VkImageView view;
+    VkResult result = vkCreateImageView(device, &image_view_info, allocation_callbacks, &view);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateImageView() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return view;
+}
+
+static VkSampler create_placeholder_sampler(VkDevice device,
+                                            const VkAllocationCallbacks *allocation_callbacks) {
+    const VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+
+    VkSampler sampler;
+    VkResult result = vkCreateSampler(device, &sampler_info, allocation_callbacks, &sampler);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateSampler() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return sampler;
+}
+
+static bool create_placeholders(const Device *device, VmaAllocator allocator, Bindless_Set *set) {
+    set->placeholder_buffer =
+        create_placeholder_buffer(allocator, &set->placeholder_buffer_allocation);
+    if (!set->placeholder_buffer) {
+        fprintf(stderr, "create_placeholder_buffer() failed\n");
+        return false;
+    }
+
+    set->placeholder_image =
+        create_placeholder_image(allocator, &set->placeholder_image_allocation);
+    if (!set->placeholder_image) {
+        fprintf(stderr, "create_placeholder_image() failed\n");
+        return false;
+    }
+
+    set->placeholder_view = create_placeholder_view(
+        device->device, host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_IMAGE),
+        set->placeholder_image);
+    if (!set->placeholder_view) {
+        fprintf(stderr, "create_placeholder_view() failed\n");
+        return false;
+    }
+
+    set->placeholder_sampler = create_placeholder_sampler(
+        device->device, host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_IMAGE));
+    if (!set->placeholder_sampler) {
+        fprintf(stderr, "create_placeholder_sampler() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Points every slot from the first free one on at its placeholder. */
+static void write_placeholders(const Device *device, const Bindless_Set *set) {
+    VkDescriptorBufferInfo buffer_infos[FIXED_MAX_BUFFERS];
+    VkDescriptorImageInfo image_infos[FIXED_MAX_IMAGES];
+    VkDescriptorImageInfo sampler_infos[FIXED_MAX_SAMPLERS];
+
+    for (uint32_t i = 0; i < FIXED_MAX_BUFFERS; i++) {
+        buffer_infos[i] = (VkDescriptorBufferInfo){
+            .buffer = set->placeholder_buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+    }
+
+    for (uint32_t i = 0; i < FIXED_MAX_IMAGES; i++) {
+        image_infos[i] = (VkDescriptorImageInfo){
+            .imageView = set->placeholder_view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+    }
+
+    for (uint32_t i = 0; i < FIXED_MAX_SAMPLERS; i++) {
+        sampler_infos[i] = (VkDescriptorImageInfo){
+            .sampler = set->placeholder_sampler,
+        };
+    }
+
+    const Bindless_Layout *layout = set->layout;
+    VkWriteDescriptorSet writes[3];
+    uint32_t write_count = 0;
+
+    if (set->buffer_count < layout->buffer_capacity) {
+        writes[write_count++] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set->set,
+            .dstBinding = SCENE_BINDING_BUFFERS,
+            .dstArrayElement = set->buffer_count,
+            .descriptorCount = layout->buffer_capacity - set->buffer_count,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = buffer_infos,
+        };
+    }
+
+    if (set->image_count < layout->image_capacity) {
+        writes[write_count++] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set->set,
+            .dstBinding = SCENE_BINDING_IMAGES,
+            .dstArrayElement = set->image_count,
+            .descriptorCount = layout->image_capacity - set->image_count,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .pImageInfo = image_infos,
+        };
+    }
+
+    if (set->sampler_count < layout->sampler_capacity) {
+        writes[write_count++] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set->set,
+            .dstBinding = SCENE_BINDING_SAMPLERS,
+            .dstArrayElement = set->sampler_count,
+            .descriptorCount = layout->sampler_capacity - set->sampler_count,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .pImageInfo = sampler_infos,
+        };
+    }
+
+    device->fn.vkUpdateDescriptorSets(device->device, write_count, writes, 0, NULL);
+}
+
+bool create_bindless_set(const Device *device, VmaAllocator allocator,
+                         const Bindless_Layout *layout, Bindless_Set *set) {
+    assert(device);
+    assert(allocator);
+    assert(layout);
+    assert(set);
+    assert(layout->bindless || (layout->buffer_capacity <= FIXED_MAX_BUFFERS &&
+                                layout->image_capacity <= FIXED_MAX_IMAGES &&
+                                layout->sampler_capacity <= FIXED_MAX_SAMPLERS));
+
+    *set = (Bindless_Set){
+        .layout = layout,
+    };
+
+    set->pool = create_pool(
+        device->device,
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_DESCRIPTOR), layout);
+    if (!set->pool) {
+        fprintf(stderr, "create_pool() failed\n");
+        return false;
+    }
+
+    set->set = allocate_set(device->device, set->pool, layout->set_layout);
+    if (!set->set) {
+        fprintf(stderr, "allocate_set() failed\n");
+        return false;
+    }
+
+    if (!layout->bindless) {
+        if (!create_placeholders(device, allocator, set)) {
+            fprintf(stderr, "create_placeholders() failed\n");
+            return false;
+        }
+
+        write_placeholders(device, set);
+    }
+
+    return true;
+}
+
+void destroy_bindless_set(const Device *device, VmaAllocator allocator, Bindless_Set *set) {
+    VkDevice vk_device = device->device;
+    Host_Allocator *host_allocator = device->host_allocator;
+
+    vkDestroySampler(vk_device, set->placeholder_sampler,
+                     host_allocator_callbacks(host_allocator, HOST_ALLOCATION_IMAGE));
+    vkDestroyImageView(vk_device, set->placeholder_view,
+                       host_allocator_callbacks(host_allocator, HOST_ALLOCATION_IMAGE));
+    vmaDestroyImage(allocator, set->placeholder_image, set->placeholder_image_allocation);
+    vmaDestroyBuffer(allocator, set->placeholder_buffer, set->placeholder_buffer_allocation);
+    vkDestroyDescriptorPool(vk_device, set->pool,
+                            host_allocator_callbacks(host_allocator, HOST_ALLOCATION_DESCRIPTOR));
+}
+
+/* Takes the next free index of an array with `capacity` slots. */
+static bool take_slot(uint32_t *count, uint32_t capacity, const char *what, uint32_t *out_index) {
+    if (*count == capacity) {
+        fprintf(stderr, "All %u scene %s slots are in use\n", capacity, what);
+        return false;
+    }
+
+    *out_index = (*count)++;
+    return true;
+}
+
+bool add_bindless_buffer(const Device *device, Bindless_Set *set, VkBuffer buffer,
+                         VkDeviceSize offset, VkDeviceSize range, uint32_t *out_index) {
+    assert(device);
+    assert(set);
+    assert(buffer);
+    assert(out_index);
+
+    uint32_t index;
+    if (!take_slot(&set->buffer_count, set->layout->buffer_capacity, "buffer", &index)) {
+        return false;
+    }
+
+    const VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set->set,
+        .dstBinding = SCENE_BINDING_BUFFERS,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo =
+            &(VkDescriptorBufferInfo){
+                .buffer = buffer,
+                .offset = offset,
+                .range = range,
+            },
+    };
+
+    device->fn.vkUpdateDescriptorSets(device->device, 1, &write, 0, NULL);
+    *out_index = index;
+    return true;
+}
+
+bool add_bindless_image(const Device *device, Bindless_Set *set, VkImageView view,
+                        uint32_t *out_index) {
+    assert(device);
+    assert(set);
+    assert(view);
+    assert(out_index);
+
+    uint32_t index;
+    if (!take_slot(&set->image_count, set->layout->image_capacity, "image", &index)) {
+        return false;
+    }
+
+    const VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set->set,
+        .dstBinding = SCENE_BINDING_IMAGES,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo =
+            &(VkDescriptorImageInfo){
+                .imageView = view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            },
+    };
+
+    device->fn.vkUpdateDescriptorSets(device->device, 1, &write, 0, NULL);
+    *out_index = index;
+    return true;
+}
+
+bool add_bindless_sampler(const Device *device, Bindless_Set *set, VkSampler sampler,
+                          uint32_t *out_index) {
+    assert(device);
+    assert(set);
+    assert(sampler);
+    assert(out_index);
+
+    uint32_t index;
+    if (!take_slot(&set->sampler_count, set->layout->sampler_capacity, "sampler", &index)) {
+        return false;
+    }
+
+    const VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set->set,
+        .dstBinding = SCENE_BINDING_SAMPLERS,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .pImageInfo =
+            &(VkDescriptorImageInfo){
+                .sampler = sampler,
+            },
+    };
+
+    device->fn.vkUpdateDescriptorSets(device->device, 1, &write, 0, NULL);
+    *out_index = index;
+    return true;
+}
+
+void clear_bindless_set(const Device *device, Bindless_Set *set) {
+    assert(device);
+    assert(set);
+
+    set->buffer_count = 0;
+    set->image_count = 0;
+    set->sampler_count = 0;
+
+    /* Partially bound slots may keep stale descriptors, as no kernel reads them. */
+    if (!set->layout->bindless) {
+        write_placeholders(device, set);
+    }
+}
+
+void record_bindless_set_start(const Device *device, const Bindless_Set *set,
+                               VkCommandBuffer command_buffer) {
+    if (!set->placeholder_image) {
+        return;
+    }
+
+    /* Only the previous frame's reads came before, which need no access scope. */
+    const VkImageMemoryBarrier to_shader_read = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = set->placeholder_image,
+        .subresourceRange = color_subresource_range,
+    };
+
+    device->fn.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1,
+                                    &to_shader_read);
+}
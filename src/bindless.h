@@ -0,0 +1,78 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+/* Layout of the scene descriptor set (SCENE_SET in scene_bindings.h), shared by every kernel. With
+ * descriptor indexing its arrays are large, partially bound and updatable after binding; otherwise
+ * they have the FIXED_MAX_* sizes and every slot must hold a descriptor.
+ */
+typedef struct Bindless_Layout {
+    bool bindless;
+    uint32_t buffer_capacity;
+    uint32_t image_capacity;
+    uint32_t sampler_capacity;
+    VkDescriptorSetLayout set_layout;
+} Bindless_Layout;
+
+bool create_bindless_layout(const Device *device, Bindless_Layout *layout);
+void destroy_bindless_layout(const Device *device, Bindless_Layout *layout);
+
+/* A scene descriptor set and the slots handed out so far. Slots are handed out in order and only
+ * given back all at once by clear_bindless_set(), so a scene loads by adding its resources and
+ * its kernels reach them by the returned indices, without new layouts or pipelines.
+ *
+ * Without descriptor indexing, unused slots point at placeholders owned by the set, and the set
+ * must not change while a command buffer that binds it is pending or recorded for replay: make
+ * every addition before the renderer records its passes in the first begin_frame().
+ */
+typedef struct Bindless_Set {
+    const Bindless_Layout *layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+
+    uint32_t buffer_count;
+    uint32_t image_count;
+    uint32_t sampler_count;
+
+    /* Placeholders; VK_NULL_HANDLE with descriptor indexing. */
+    VkBuffer placeholder_buffer;
+    VmaAllocation placeholder_buffer_allocation;
+    VkImage placeholder_image;
+    VmaAllocation placeholder_image_allocation;
+    VkImageView placeholder_view;
+    VkSampler placeholder_sampler;
+} Bindless_Set;
+
+/* Allocates a set of `layout`, which must outlive it. */
+bool create_bindless_set(const Device *device, VmaAllocator allocator,
+                         const Bindless_Layout *layout, Bindless_Set *set);
+void destroy_bindless_set(const Device *device, VmaAllocator allocator, Bindless_Set *set);
+
+/* Each writes the next free slot of its array and returns its index in `out_index`. Fails when
+ * the array is full. Images must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when read.
+ */
+bool add_bindless_buffer(const Device *device, Bindless_Set *set, VkBuffer buffer,
+                         VkDeviceSize offset, VkDeviceSize range, uint32_t *out_index);
+bool add_bindless_image(const Device *device, Bindless_Set *set, VkImageView view,
+                        uint32_t *out_index);
+bool add_bindless_sampler(const Device *device, Bindless_Set *set, VkSampler sampler,
+                          uint32_t *out_index);
+
+/* Gives back every slot, pointing them at the placeholders again where there are any. Work that
+ * reads the previous scene must have completed.
+ */
+void clear_bindless_set(const Device *device, Bindless_Set *set);
+
+/* Moves the placeholder image into the layout its descriptors name. Contents are discarded, so
+ * recording this at the start of every frame is harmless; does nothing with descriptor indexing.
+ */
+void record_bindless_set_start(const Device *device, const Bindless_Set *set,
+                               VkCommandBuffer command_buffer);
+
+#endif /* BINDLESS_H */
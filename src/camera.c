@@ -0,0 +1,63 @@
+#include "camera.h"
+
+#include <assert.h>
+#include <math.h>
+
+static void normalize(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+static void cross(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+Camera default_camera(void) {
+    return (Camera){
+        .position = {0.0f, 0.0f, 0.0f},
+        .target = {0.0f, 0.0f, -1.0f},
+        .fov_degrees = 60.0f,
+    };
+}
+
+Camera_Basis get_camera_basis(const Camera *camera, float aspect) {
+    assert(camera);
+    assert(aspect > 0.0f);
+
+    float forward[3] = {
+        camera->target[0] - camera->position[0],
+        camera->target[1] - camera->position[1],
+        camera->target[2] - camera->position[2],
+    };
+    normalize(forward);
+
+    /* Looking straight up or down leaves +y no use as a reference, so -z stands in for it. */
+    float world_up[3] = {0.0f, 1.0f, 0.0f};
+    if (fabsf(forward[1]) > 0.999f) {
+        world_up[1] = 0.0f;
+        world_up[2] = -1.0f;
+    }
+
+    float right[3];
+    cross(forward, world_up, right);
+    normalize(right);
+
+    float up[3];
+    cross(right, forward, up);
+
+    float half_height = tanf(camera->fov_degrees * 0.5f * 3.14159265f / 180.0f);
+    float half_width = half_height * aspect;
+
+    return (Camera_Basis){
+        .origin = {camera->position[0], camera->position[1], camera->position[2], 0.0f},
+        .forward = {forward[0], forward[1], forward[2], 0.0f},
+        .right = {right[0] * half_width, right[1] * half_width, right[2] * half_width, 0.0f},
+        .up = {up[0] * half_height, up[1] * half_height, up[2] * half_height, 0.0f},
+    };
+}
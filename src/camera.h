@@ -0,0 +1,30 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+/* A pinhole camera looking from `position` at `target`, with +y up. */
+typedef struct Camera {
+    float position[3];
+    float target[3];
+
+    /* Vertical field of view in degrees. */
+    float fov_degrees;
+} Camera;
+
+/* World-space vectors the kernel builds primary rays from: a ray through normalised image
+ * coordinates (u, v) points along forward + (2u - 1) * right + (1 - 2v) * up. The fourth
+ * components pad each vector to a vec4 in std140 and are zero.
+ */
+typedef struct Camera_Basis {
+    float origin[4];
+    float forward[4];
+    float right[4];
+    float up[4];
+} Camera_Basis;
+
+/* At the origin looking down -z, with a 60 degree field of view. */
+Camera default_camera(void);
+
+/* `aspect` is the width of the whole output over its height. */
+Camera_Basis get_camera_basis(const Camera *camera, float aspect);
+
+#endif /* CAMERA_H */
@@ -1,11 +1,20 @@
 #include "device.h"
 
 #include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
 
-static uint32_t find_compute_queue_index(VkPhysicalDevice physical_device) {
+#include "host_allocator.h"
+#include "instance.h"
+
+/* Also returns the family's timestampValidBits, zero if it cannot write timestamps. */
+static uint32_t find_compute_queue_index(VkPhysicalDevice physical_device,
+                                         uint32_t *out_timestamp_valid_bits) {
     uint32_t queue_family_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, NULL);
     VkQueueFamilyProperties *properties = malloc(sizeof(*properties) * queue_family_count);
@@ -13,6 +22,7 @@ static uint32_t find_compute_queue_index(VkPhysicalDevice physical_device) {
 
     for (uint32_t i = 0; i < queue_family_count; i++) {
         if (properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            *out_timestamp_valid_bits = properties[i].timestampValidBits;
             free(properties);
             return i;
         }
@@ -27,90 +37,536 @@ static uint32_t find_compute_queue_index(VkPhysicalDevice physical_device) {
     return 0;
 }
 
-static void get_physical_device_info(VkPhysicalDevice physical_device,
+/* Finds a family with TRANSFER but neither GRAPHICS nor COMPUTE, which on discrete GPUs maps to
+ * the copy engines that run independently of the compute units.
+ */
+static bool find_transfer_queue_index(VkPhysicalDevice physical_device, uint32_t *out_index) {
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, NULL);
+    VkQueueFamilyProperties *properties = malloc(sizeof(*properties) * queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, properties);
+
+    const VkQueueFlags general_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (uint32_t i = 0; i < queue_family_count; i++) {
+        if ((properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(properties[i].queueFlags & general_flags) && properties[i].queueCount > 0) {
+            free(properties);
+            *out_index = i;
+            return true;
+        }
+    }
+
+    free(properties);
+    return false;
+}
+
+static void get_memory_sizes(Physical_Device_Info *info) {
+    const VkPhysicalDeviceMemoryProperties *memory = &info->memory_properties;
+
+    for (uint32_t i = 0; i < memory->memoryHeapCount; i++) {
+        const VkMemoryHeap *heap = &memory->memoryHeaps[i];
+        if ((heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            heap->size > info->device_local_bytes) {
+            info->device_local_bytes = heap->size;
+        }
+    }
+
+    const VkMemoryPropertyFlags host_visible_device_local =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    for (uint32_t i = 0; i < memory->memoryTypeCount; i++) {
+        const VkMemoryType *type = &memory->memoryTypes[i];
+        VkDeviceSize heap_size = memory->memoryHeaps[type->heapIndex].size;
+        if ((type->propertyFlags & host_visible_device_local) == host_visible_device_local &&
+            heap_size > info->host_visible_device_local_bytes) {
+            info->host_visible_device_local_bytes = heap_size;
+        }
+    }
+}
+
+/* Feature structs passed to vkGetPhysicalDeviceFeatures2() and, trimmed to what we use, to
+ * vkCreateDevice().
+ */
+typedef struct Feature_Chain {
+    VkPhysicalDeviceFeatures2 features2;
+    VkPhysicalDeviceVulkan12Features vulkan12;
+    VkPhysicalDeviceVulkan13Features vulkan13;
+} Feature_Chain;
+
+static void init_feature_chain(uint32_t api_version, Feature_Chain *chain) {
+    *chain = (Feature_Chain){
+        .features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .vulkan12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .vulkan13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+    };
+
+    chain->features2.pNext = &chain->vulkan12;
+    if (api_version >= VK_API_VERSION_1_3) {
+        chain->vulkan12.pNext = &chain->vulkan13;
+    }
+}
+
+static void query_device_features(VkPhysicalDevice physical_device, uint32_t api_version,
+                                  Device_Features *out_features) {
+    *out_features = (Device_Features){0};
+
+    if (api_version < VK_API_VERSION_1_2) {
+        return;
+    }
+
+    Feature_Chain supported;
+    init_feature_chain(api_version, &supported);
+    vkGetPhysicalDeviceFeatures2(physical_device, &supported.features2);
+
+    const VkPhysicalDeviceVulkan12Features *v12 = &supported.vulkan12;
+    out_features->timeline_semaphore = v12->timelineSemaphore;
+    out_features->buffer_device_address = v12->bufferDeviceAddress;
+    out_features->shader_float16 = v12->shaderFloat16;
+    out_features->shader_int8 = v12->shaderInt8;
+    out_features->descriptor_indexing =
+        v12->descriptorIndexing && v12->runtimeDescriptorArray &&
+        v12->descriptorBindingPartiallyBound && v12->descriptorBindingUpdateUnusedWhilePending &&
+        v12->descriptorBindingStorageBufferUpdateAfterBind &&
+        v12->descriptorBindingSampledImageUpdateAfterBind &&
+        v12->shaderStorageBufferArrayNonUniformIndexing &&
+        v12->shaderSampledImageArrayNonUniformIndexing;
+
+    if (api_version < VK_API_VERSION_1_3) {
+        return;
+    }
+
+    const VkPhysicalDeviceVulkan13Features *v13 = &supported.vulkan13;
+    out_features->synchronization2 = v13->synchronization2;
+    out_features->subgroup_size_control = v13->subgroupSizeControl && v13->computeFullSubgroups;
+
+    if (out_features->subgroup_size_control) {
+        VkPhysicalDeviceVulkan13Properties properties13 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_PROPERTIES,
+        };
+
+        VkPhysicalDeviceProperties2 properties2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &properties13,
+        };
+
+        vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+        out_features->min_subgroup_size = properties13.minSubgroupSize;
+        out_features->max_subgroup_size = properties13.maxSubgroupSize;
+    }
+}
+
+/* Builds the chain of features to enable from what query_device_features() found. */
+static void get_enabled_features(uint32_t api_version, const Device_Features *features,
+                                 Feature_Chain *chain) {
+    init_feature_chain(api_version, chain);
+
+    VkPhysicalDeviceVulkan12Features *v12 = &chain->vulkan12;
+    v12->timelineSemaphore = features->timeline_semaphore;
+    v12->bufferDeviceAddress = features->buffer_device_address;
+    v12->shaderFloat16 = features->shader_float16;
+    v12->shaderInt8 = features->shader_int8;
+    if (features->descriptor_indexing) {
+        v12->descriptorIndexing = VK_TRUE;
+        v12->runtimeDescriptorArray = VK_TRUE;
+        v12->descriptorBindingPartiallyBound = VK_TRUE;
+        v12->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        v12->descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        v12->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        v12->shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        v12->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    }
+
+    VkPhysicalDeviceVulkan13Features *v13 = &chain->vulkan13;
+    v13->synchronization2 = features->synchronization2;
+    v13->subgroupSizeControl = features->subgroup_size_control;
+    v13->computeFullSubgroups = features->subgroup_size_control;
+}
+
+static void print_device_features(const Physical_Device_Info *info) {
+    const Device_Features *features = &info->features;
+    fprintf(stderr,
+            "Device features (Vulkan %u.%u): timeline_semaphore=%d synchronization2=%d "
+            "buffer_device_address=%d shader_float16=%d shader_int8=%d "
+            "subgroup_size_control=%d [%u, %u] descriptor_indexing=%d\n",
+            VK_API_VERSION_MAJOR(info->api_version), VK_API_VERSION_MINOR(info->api_version),
+            features->timeline_semaphore, features->synchronization2,
+            features->buffer_device_address, features->shader_float16, features->shader_int8,
+            features->subgroup_size_control, features->min_subgroup_size,
+            features->max_subgroup_size, features->descriptor_indexing);
+}
+
+static void get_physical_device_info(VkPhysicalDevice physical_device, uint32_t index,
+                                     uint32_t instance_api_version,
                                      Physical_Device_Info *out_info) {
     assert(out_info);
     assert(physical_device);
 
     *out_info = (Physical_Device_Info){
         .physical_device = physical_device,
+        .index = index,
     };
 
     vkGetPhysicalDeviceMemoryProperties(physical_device, &out_info->memory_properties);
     vkGetPhysicalDeviceProperties(physical_device, &out_info->properties);
 
-    out_info->compute_family_index = find_compute_queue_index(out_info->physical_device);
+    out_info->api_version = out_info->properties.apiVersion < instance_api_version
+                                ? out_info->properties.apiVersion
+                                : instance_api_version;
+
+    if (out_info->api_version >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceIDProperties id_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        };
+
+        VkPhysicalDeviceSubgroupProperties subgroup_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+            .pNext = &id_properties,
+        };
+
+        VkPhysicalDeviceProperties2 properties2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &subgroup_properties,
+        };
+
+        vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+
+        out_info->has_device_uuid = true;
+        memcpy(out_info->device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+        out_info->subgroup_size = subgroup_properties.subgroupSize;
+    }
+
+    query_device_features(physical_device, out_info->api_version, &out_info->features);
+    get_memory_sizes(out_info);
+    out_info->compute_family_index = find_compute_queue_index(
+        out_info->physical_device, &out_info->compute_timestamp_valid_bits);
+    out_info->has_transfer_family =
+        find_transfer_queue_index(out_info->physical_device, &out_info->transfer_family_index);
+    if (!out_info->has_transfer_family) {
+        out_info->transfer_family_index = out_info->compute_family_index;
+    }
+}
+
+/* Points between device types. Every capability term below is capped so that together they stay
+ * under this, which makes the type a primary key: a discrete GPU always outranks an integrated one,
+ * whatever memory a software device on a large host reports.
+ */
+#define DEVICE_TYPE_WEIGHT 16384
+
+/* Caps `value` at `max`, for the capped terms of rate_physical_device(). */
+static int64_t capped(uint64_t value, uint64_t max) {
+    return (int64_t)(value > max ? max : value);
 }
 
-static int rate_physical_device(const Physical_Device_Info *info) {
-    int score = 0;
-    if (info->properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-        score += 100;
+/* Ranks devices by what matters for a compute-only path tracer. The device type separates
+ * discrete, integrated, virtual and software devices first; within a type, the weights keep each
+ * capability term in a similar range so that no single property dominates. Ties keep enumeration
+ * order.
+ */
+static int64_t rate_physical_device(const Physical_Device_Info *info) {
+    const VkPhysicalDeviceLimits *limits = &info->properties.limits;
+
+    int64_t type_rank = 0;
+    switch (info->properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        type_rank = 3;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        type_rank = 2;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        type_rank = 1;
+        break;
+    default:
+        break;
     }
 
-    return score;
+    /* Typically 128-1024, capped at 4096. */
+    int64_t score = capped(limits->maxComputeWorkGroupInvocations, 4096);
+
+    /* Typically 16-64 KiB, scaled to 256-1024 and capped at 4096. */
+    score += capped(limits->maxComputeSharedMemorySize / 64, 4096);
+
+    /* Typically 4-64 lanes, scaled to 32-512 and capped at 1024. */
+    score += capped(info->subgroup_size, 128) * 8;
+
+    /* One point per 16 MiB of device-local memory, capped at 64 GiB. */
+    score += capped(info->device_local_bytes >> 20, 65536) / 16;
+
+    /* Host-visible device-local memory allows zero-copy readback; one point per 32 MiB, capped at
+     * 64 GiB.
+     */
+    score += capped(info->host_visible_device_local_bytes >> 20, 65536) / 32;
+
+    /* At most 4096 + 4096 + 1024 + 4096 + 2048 = 15360. */
+    assert(score < DEVICE_TYPE_WEIGHT);
+    return type_rank * DEVICE_TYPE_WEIGHT + score;
 }
 
-static bool find_best_physical_device(VkInstance instance, Physical_Device_Info *out_info) {
+/* Parses a UUID written as 32 hex digits with optional dashes. */
+static bool parse_uuid(const char *string, uint8_t out_uuid[VK_UUID_SIZE]) {
+    uint32_t digit_count = 0;
+    for (const char *c = string; *c; c++) {
+        if (*c == '-') {
+            continue;
+        }
+
+        int value;
+        if (*c >= '0' && *c <= '9') {
+            value = *c - '0';
+        } else if (*c >= 'a' && *c <= 'f') {
+            value = *c - 'a' + 10;
+        } else if (*c >= 'A' && *c <= 'F') {
+            value = *c - 'A' + 10;
+        } else {
+            return false;
+        }
+
+        if (digit_count >= VK_UUID_SIZE * 2) {
+            return false;
+        }
+
+        if (digit_count % 2 == 0) {
+            out_uuid[digit_count / 2] = (uint8_t)(value << 4);
+        } else {
+            out_uuid[digit_count / 2] |= (uint8_t)value;
+        }
+
+        digit_count++;
+    }
+
+    return digit_count == VK_UUID_SIZE * 2;
+}
+
+static bool parse_index(const char *string, uint32_t *out_index) {
+    if (!*string) {
+        return false;
+    }
+
+    uint32_t index = 0;
+    for (const char *c = string; *c; c++) {
+        if (*c < '0' || *c > '9' || index > UINT32_MAX / 10) {
+            return false;
+        }
+
+        index = index * 10 + (uint32_t)(*c - '0');
+    }
+
+    *out_index = index;
+    return true;
+}
+
+/* Returns the position in `infos` of the device matching `selector`, or -1. */
+static int64_t find_selected_device(const Physical_Device_Info *infos, uint32_t count,
+                                    const char *selector) {
+    uint32_t index;
+    if (parse_index(selector, &index)) {
+        return index < count ? (int64_t)index : -1;
+    }
+
+    uint8_t uuid[VK_UUID_SIZE];
+    if (parse_uuid(selector, uuid)) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (infos[i].has_device_uuid && memcmp(infos[i].device_uuid, uuid, VK_UUID_SIZE) == 0) {
+                return i;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(infos[i].properties.deviceName, selector) == 0) {
+            return i;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (strstr(infos[i].properties.deviceName, selector)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void print_physical_device(const Physical_Device_Info *info, int64_t score,
+                                  bool selected) {
+    fprintf(stderr, "%s [%u] %s (%s, Vulkan %u.%u) score %lld: %u invocations, %u B shared, "
+                    "subgroup %u, %llu MiB device-local, %llu MiB host-visible device-local\n",
+            selected ? "*" : " ", info->index, info->properties.deviceName,
+            string_VkPhysicalDeviceType(info->properties.deviceType),
+            VK_API_VERSION_MAJOR(info->api_version), VK_API_VERSION_MINOR(info->api_version),
+            (long long)score, info->properties.limits.maxComputeWorkGroupInvocations,
+            info->properties.limits.maxComputeSharedMemorySize, info->subgroup_size,
+            (unsigned long long)(info->device_local_bytes >> 20),
+            (unsigned long long)(info->host_visible_device_local_bytes >> 20));
+
+    if (info->has_device_uuid) {
+        fprintf(stderr, "      uuid ");
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            fprintf(stderr, "%02x", info->device_uuid[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+static bool find_best_physical_device(const Instance *instance, const Device_Info *device_info,
+                                      Physical_Device_Info *out_info) {
     assert(instance);
+    assert(device_info);
     assert(out_info);
 
     *out_info = (Physical_Device_Info){0};
 
     uint32_t device_count = 0;
-    vkEnumeratePhysicalDevices(instance, &device_count, NULL);
+    vkEnumeratePhysicalDevices(instance->instance, &device_count, NULL);
+    if (device_count == 0) {
+        return false;
+    }
+
     VkPhysicalDevice *physical_devices = malloc(sizeof(*physical_devices) * device_count);
-    vkEnumeratePhysicalDevices(instance, &device_count, physical_devices);
+    Physical_Device_Info *infos = malloc(sizeof(*infos) * device_count);
+    int64_t *scores = malloc(sizeof(*scores) * device_count);
+    vkEnumeratePhysicalDevices(instance->instance, &device_count, physical_devices);
 
-    int best_score = INT_MIN;
+    int64_t best = -1;
     for (uint32_t i = 0; i < device_count; i++) {
-        Physical_Device_Info info;
-        get_physical_device_info(physical_devices[i], &info);
+        get_physical_device_info(physical_devices[i], i, instance->api_version, &infos[i]);
+
+        scores[i] = rate_physical_device(&infos[i]);
+        if (best < 0 || scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+
+    if (device_info->selector) {
+        best = find_selected_device(infos, device_count, device_info->selector);
+        if (best < 0) {
+            fprintf(stderr, "No physical device matches \"%s\"\n", device_info->selector);
+        }
+    }
 
-        int score = rate_physical_device(&info);
-        if (score > best_score) {
-            best_score = score;
-            *out_info = info;
+    if (device_info->verbose || best < 0) {
+        for (uint32_t i = 0; i < device_count; i++) {
+            print_physical_device(&infos[i], scores[i], i == best);
         }
     }
 
+    if (best >= 0) {
+        *out_info = infos[best];
+    }
+
+    free(scores);
+    free(infos);
     free(physical_devices);
     return out_info->physical_device != NULL;
 }
 
-bool create_device(VkInstance instance, Device *dev) {
+static bool load_device_functions(VkDevice device, const Device_Features *features,
+                                  Device_Functions *fn) {
+    bool complete = true;
+
+#define LOAD_DEVICE_FUNCTION(name)                                                                 \
+    fn->name = (PFN_##name)vkGetDeviceProcAddr(device, #name);                                     \
+    if (!fn->name) {                                                                               \
+        fprintf(stderr, "vkGetDeviceProcAddr() returned NULL for %s\n", #name);                    \
+        complete = false;                                                                          \
+    }
+
+    DEVICE_FUNCTIONS(LOAD_DEVICE_FUNCTION)
+    if (features->timeline_semaphore) {
+        DEVICE_TIMELINE_SEMAPHORE_FUNCTIONS(LOAD_DEVICE_FUNCTION)
+    }
+#undef LOAD_DEVICE_FUNCTION
+
+    return complete;
+}
+
+bool create_device(const Instance *instance, const Device_Info *info, Device *dev) {
     assert(instance);
+    assert(info);
     assert(dev);
 
-    if (!find_best_physical_device(instance, &dev->info)) {
+    *dev = (Device){
+        .host_allocator = info->host_allocator,
+    };
+
+    if (!find_best_physical_device(instance, info, &dev->info)) {
         fprintf(stderr, "Failed to find a suitable physical device\n");
         return false;
     }
 
+    dev->async_transfer = dev->info.has_transfer_family && !info->disable_transfer_queue;
+
     const float queue_priority = 1.0f;
-    const VkDeviceQueueCreateInfo queue_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = dev->info.compute_family_index,
-        .queueCount = 1,
-        .pQueuePriorities = &queue_priority,
+    const VkDeviceQueueCreateInfo queue_infos[] = {
+        (VkDeviceQueueCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = dev->info.compute_family_index,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        },
+
+        (VkDeviceQueueCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = dev->info.transfer_family_index,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        },
     };
 
+    /* Vulkan 1.0 devices take no feature chain; VkPhysicalDeviceVulkan12Features is only valid
+     * in the pNext chain of a 1.2 device.
+     */
+    Feature_Chain enabled_features;
+    get_enabled_features(dev->info.api_version, &dev->info.features, &enabled_features);
+
     const VkDeviceCreateInfo device_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pQueueCreateInfos = &queue_info,
-        .queueCreateInfoCount = 1,
+        .pNext = dev->info.api_version >= VK_API_VERSION_1_2 ? &enabled_features.features2 : NULL,
+        .pQueueCreateInfos = queue_infos,
+        .queueCreateInfoCount = dev->async_transfer ? 2 : 1,
     };
 
-    VkResult result = vkCreateDevice(dev->info.physical_device, &device_info, NULL, &dev->device);
+    const VkAllocationCallbacks *allocation_callbacks =
+        host_allocator_callbacks(dev->host_allocator, HOST_ALLOCATION_DEVICE);
+
+    VkResult result = vkCreateDevice(dev->info.physical_device, &device_info, allocation_callbacks,
+                                     &dev->device);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "vkCreateDevice() failed: %s\n", string_VkResult(result));
         return false;
     }
 
-    vkGetDeviceQueue(dev->device, dev->info.compute_family_index, 0, &dev->compute_queue);
+    if (!load_device_functions(dev->device, &dev->info.features, &dev->fn)) {
+        fprintf(stderr, "load_device_functions() failed\n");
+        vkDestroyDevice(dev->device, allocation_callbacks);
+        return false;
+    }
+
+    if (info->verbose) {
+        print_device_features(&dev->info);
+    }
+
+    dev->fn.vkGetDeviceQueue(dev->device, dev->info.compute_family_index, 0, &dev->compute_queue);
+
+    if (dev->async_transfer) {
+        dev->fn.vkGetDeviceQueue(dev->device, dev->info.transfer_family_index, 0,
+                                 &dev->transfer_queue);
+    } else {
+        dev->transfer_queue = dev->compute_queue;
+    }
+
+    if (info->verbose) {
+        fprintf(stderr, "Compute queue family %u, transfer queue family %u (%s)\n",
+                dev->info.compute_family_index,
+                dev->async_transfer ? dev->info.transfer_family_index
+                                    : dev->info.compute_family_index,
+                dev->async_transfer ? "dedicated" : "shared with compute");
+    }
+
     return true;
 }
 
 void destroy_device(Device *device) {
-    vkDestroyDevice(device->device, NULL);
+    device->fn.vkDestroyDevice(device->device,
+                               host_allocator_callbacks(device->host_allocator,
+                                                        HOST_ALLOCATION_DEVICE));
 }
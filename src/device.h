@@ -6,22 +6,152 @@
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+#include "host_allocator.h"
+#include "instance.h"
+
+/* Optional Vulkan 1.2/1.3 capabilities. Each flag is set only when the device supports the feature
+ * and it was enabled at device creation, so callers can branch on these directly. Devices below
+ * 1.2 report none of them.
+ */
+typedef struct Device_Features {
+    bool timeline_semaphore;
+    bool synchronization2;
+    bool buffer_device_address;
+    bool shader_float16;
+    bool shader_int8;
+
+    /* subgroupSizeControl and computeFullSubgroups; the size range is only valid when set. */
+    bool subgroup_size_control;
+    uint32_t min_subgroup_size;
+    uint32_t max_subgroup_size;
+
+    /* The bindless subset: runtime arrays, partially bound and update-after-bind storage buffers
+     * and sampled images, with non-uniform indexing.
+     */
+    bool descriptor_indexing;
+} Device_Features;
+
 typedef struct Physical_Device_Info {
     VkPhysicalDevice physical_device;
     VkPhysicalDeviceProperties properties;
     VkPhysicalDeviceMemoryProperties memory_properties;
 
+    /* Position in vkEnumeratePhysicalDevices(); stable for a given driver setup. */
+    uint32_t index;
+
+    /* Core version usable with this device: the lower of the device's and the instance's. */
+    uint32_t api_version;
+
+    /* Only available on Vulkan 1.1 devices; zero otherwise. */
+    bool has_device_uuid;
+    uint8_t device_uuid[VK_UUID_SIZE];
+    uint32_t subgroup_size;
+
+    /* Size of the largest DEVICE_LOCAL heap. */
+    VkDeviceSize device_local_bytes;
+
+    /* Size of the largest heap with a DEVICE_LOCAL | HOST_VISIBLE memory type (UMA or BAR). */
+    VkDeviceSize host_visible_device_local_bytes;
+
+    Device_Features features;
+
     uint32_t compute_family_index;
+
+    /* Meaningful bits of timestamps written on the compute family; zero if it has none. */
+    uint32_t compute_timestamp_valid_bits;
+
+    /* A transfer-only family (no GRAPHICS or COMPUTE), if the device exposes one. When it does not,
+     * transfer_family_index equals compute_family_index.
+     */
+    bool has_transfer_family;
+    uint32_t transfer_family_index;
 } Physical_Device_Info;
 
+typedef struct Device_Info {
+    /* Forces a physical device instead of picking the highest-ranked one. Accepts an index into
+     * vkEnumeratePhysicalDevices(), a device UUID as 32 hex digits (dashes are ignored), or a
+     * device name, matched exactly first and then as a substring. NULL selects automatically.
+     */
+    const char *selector;
+
+    /* Keeps readbacks on the compute queue even if a transfer-only family exists. */
+    bool disable_transfer_queue;
+
+    /* Prints every candidate device with its rank. */
+    bool verbose;
+
+    /* Optional; kept by the Device so every module creating objects on it can tag them. */
+    Host_Allocator *host_allocator;
+} Device_Info;
+
+/* Device-level entry points called through Device_Functions, as X(name). Everything on the
+ * per-frame path must go through these: recording and submission, fences and queries, and the
+ * binary semaphores the job graph recreates between submits. Objects created and destroyed once
+ * may use the loader's exported symbols, where the trampoline costs nothing that matters; only
+ * list entry points something calls through the table.
+ */
+#define DEVICE_FUNCTIONS(X)                                                                        \
+    X(vkDestroyDevice)                                                                             \
+    X(vkGetDeviceQueue)                                                                            \
+    X(vkDeviceWaitIdle)                                                                            \
+    X(vkQueueSubmit)                                                                               \
+    X(vkCreateSemaphore)                                                                           \
+    X(vkDestroySemaphore)                                                                          \
+    X(vkResetFences)                                                                               \
+    X(vkWaitForFences)                                                                             \
+    X(vkGetFenceStatus)                                                                            \
+    X(vkUpdateDescriptorSets)                                                                      \
+    X(vkBeginCommandBuffer)                                                                        \
+    X(vkEndCommandBuffer)                                                                          \
+    X(vkCmdBindPipeline)                                                                           \
+    X(vkCmdBindDescriptorSets)                                                                     \
+    X(vkCmdPushConstants)                                                                          \
+    X(vkCmdDispatch)                                                                               \
+    X(vkCmdDispatchIndirect)                                                                       \
+    X(vkCmdPipelineBarrier)                                                                        \
+    X(vkCmdClearColorImage)                                                                        \
+    X(vkCmdCopyBuffer)                                                                             \
+    X(vkGetQueryPoolResults)                                                                       \
+    X(vkCmdResetQueryPool)                                                                         \
+    X(vkCmdWriteTimestamp)
+
+/* Entry points that only exist with Device_Features.timeline_semaphore. They are left NULL when
+ * the feature is not enabled.
+ */
+#define DEVICE_TIMELINE_SEMAPHORE_FUNCTIONS(X)                                                     \
+    X(vkWaitSemaphores)                                                                            \
+    X(vkSignalSemaphore)                                                                           \
+    X(vkGetSemaphoreCounterValue)
+
+/* Device-level entry points resolved with vkGetDeviceProcAddr(). Calling through these skips the
+ * loader's trampoline, which otherwise looks up the dispatch table on every call.
+ */
+typedef struct Device_Functions {
+#define DEVICE_FUNCTION_MEMBER(name) PFN_##name name;
+    DEVICE_FUNCTIONS(DEVICE_FUNCTION_MEMBER)
+    DEVICE_TIMELINE_SEMAPHORE_FUNCTIONS(DEVICE_FUNCTION_MEMBER)
+#undef DEVICE_FUNCTION_MEMBER
+} Device_Functions;
+
 typedef struct Device {
     Physical_Device_Info info;
 
     VkDevice device;
+    Device_Functions fn;
+
+    /* NULL when host allocations are not tracked. */
+    Host_Allocator *host_allocator;
+
     VkQueue compute_queue;
+
+    /* Separate queue on the transfer-only family when `async_transfer` is set; otherwise the same
+     * handle as compute_queue. Resources used on both need queue family ownership transfers.
+     */
+    VkQueue transfer_queue;
+    bool async_transfer;
 } Device;
 
-bool create_device(VkInstance instance, Device *dev);
+bool create_device(const Instance *instance, const Device_Info *info, Device *dev);
 void destroy_device(Device *dev);
 
 #endif /* DEVICE_H */
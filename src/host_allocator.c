@@ -0,0 +1,388 @@
+#include "host_allocator.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task.h"
+#include "utils.h"
+
+#define MIN_CHUNK_SHIFT 4
+#define MIN_ALIGNMENT 16
+#define ARENA_BLOCK_SIZE ((size_t)1 << 20)
+
+/* Keeps the first chunk of a block aligned to MIN_ALIGNMENT whatever the pointer size. */
+#define BLOCK_HEADER_SIZE 64
+
+/* Arena blocks and oversized allocations. Oversized ones are unlinked and freed as soon as
+ * Vulkan frees them; arena blocks live until the allocator is destroyed.
+ */
+struct Host_Allocator_Block {
+    Host_Allocator_Block *next;
+    Host_Allocator_Block *prev;
+    size_t size;
+};
+
+/* Stored immediately before every pointer handed to Vulkan. */
+typedef struct Allocation_Header {
+    void *chunk;
+    size_t chunk_size;
+    size_t size;
+    uint32_t size_class;
+    uint32_t type;
+} Allocation_Header;
+
+#define OVERSIZED_CLASS UINT32_MAX
+
+static void add_bytes(Host_Allocation_Stats *stats, size_t size) {
+    stats->current_bytes += size;
+    stats->allocation_count++;
+    if (stats->current_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->current_bytes;
+    }
+}
+
+static void remove_bytes(Host_Allocation_Stats *stats, size_t size) {
+    assert(stats->current_bytes >= size);
+    stats->current_bytes -= size;
+}
+
+static void resize_bytes(Host_Allocation_Stats *stats, size_t old_size, size_t new_size) {
+    assert(stats->current_bytes >= old_size);
+    stats->current_bytes = stats->current_bytes - old_size + new_size;
+    if (stats->current_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->current_bytes;
+    }
+}
+
+static uintptr_t align_up(uintptr_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+static void link_block(Host_Allocator *allocator, Host_Allocator_Block *block) {
+    block->prev = NULL;
+    block->next = allocator->blocks;
+    if (allocator->blocks) {
+        allocator->blocks->prev = block;
+    }
+
+    allocator->blocks = block;
+    allocator->stats.reserved_bytes += block->size;
+}
+
+static void unlink_block(Host_Allocator *allocator, Host_Allocator_Block *block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        allocator->blocks = block->next;
+    }
+
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+
+    allocator->stats.reserved_bytes -= block->size;
+}
+
+static Host_Allocator_Block *new_block(Host_Allocator *allocator, size_t size) {
+    Host_Allocator_Block *block = malloc(BLOCK_HEADER_SIZE + size);
+    if (!block) {
+        return NULL;
+    }
+
+    block->size = BLOCK_HEADER_SIZE + size;
+    link_block(allocator, block);
+    return block;
+}
+
+/* Returns a chunk of at least `needed` bytes, aligned to MIN_ALIGNMENT. Must hold the lock. */
+static void *get_chunk(Host_Allocator *allocator, size_t needed, uint32_t *out_class,
+                       size_t *out_chunk_size) {
+    uint32_t size_class = 0;
+    while (size_class < HOST_ALLOCATOR_SIZE_CLASSES &&
+           ((size_t)1 << (size_class + MIN_CHUNK_SHIFT)) < needed) {
+        size_class++;
+    }
+
+    if (size_class == HOST_ALLOCATOR_SIZE_CLASSES) {
+        Host_Allocator_Block *block = new_block(allocator, needed);
+        if (!block) {
+            return NULL;
+        }
+
+        *out_class = OVERSIZED_CLASS;
+        *out_chunk_size = needed;
+        return (char *)block + BLOCK_HEADER_SIZE;
+    }
+
+    size_t chunk_size = (size_t)1 << (size_class + MIN_CHUNK_SHIFT);
+    *out_class = size_class;
+    *out_chunk_size = chunk_size;
+
+    void *chunk = allocator->free_lists[size_class];
+    if (chunk) {
+        memcpy(&allocator->free_lists[size_class], chunk, sizeof(void *));
+        return chunk;
+    }
+
+    /* The tail of the current block is abandoned when the next chunk does not fit. It is small
+     * next to ARENA_BLOCK_SIZE because the largest class is a quarter of a block.
+     */
+    if (!allocator->current_block || allocator->block_used + chunk_size > ARENA_BLOCK_SIZE) {
+        allocator->current_block = new_block(allocator, ARENA_BLOCK_SIZE);
+        if (!allocator->current_block) {
+            return NULL;
+        }
+
+        allocator->block_used = 0;
+    }
+
+    chunk = (char *)allocator->current_block + BLOCK_HEADER_SIZE + allocator->block_used;
+    allocator->block_used += chunk_size;
+    return chunk;
+}
+
+/* Must hold the lock. */
+static void put_chunk(Host_Allocator *allocator, const Allocation_Header *header) {
+    if (header->size_class == OVERSIZED_CLASS) {
+        Host_Allocator_Block *block =
+            (Host_Allocator_Block *)(void *)((char *)header->chunk - BLOCK_HEADER_SIZE);
+        unlink_block(allocator, block);
+        free(block);
+        return;
+    }
+
+    /* The link overwrites the start of the chunk, which may be where the header lives. */
+    void *chunk = header->chunk;
+    uint32_t size_class = header->size_class;
+    memcpy(chunk, &allocator->free_lists[size_class], sizeof(void *));
+    allocator->free_lists[size_class] = chunk;
+}
+
+static Allocation_Header *get_header(void *memory) {
+    return (Allocation_Header *)(void *)((char *)memory - sizeof(Allocation_Header));
+}
+
+static void *allocate_locked(Host_Allocator *allocator, Host_Allocation_Type type, size_t size,
+                             size_t alignment) {
+    if (alignment < MIN_ALIGNMENT) {
+        alignment = MIN_ALIGNMENT;
+    }
+
+    size_t needed = sizeof(Allocation_Header) + alignment - 1 + size;
+
+    uint32_t size_class;
+    size_t chunk_size;
+    void *chunk = get_chunk(allocator, needed, &size_class, &chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+
+    uintptr_t memory = align_up((uintptr_t)chunk + sizeof(Allocation_Header), alignment);
+    Allocation_Header *header = get_header((void *)memory);
+    *header = (Allocation_Header){
+        .chunk = chunk,
+        .chunk_size = chunk_size,
+        .size = size,
+        .size_class = size_class,
+        .type = (uint32_t)type,
+    };
+
+    add_bytes(&allocator->stats.types[type], size);
+    add_bytes(&allocator->stats.total, size);
+    return (void *)memory;
+}
+
+static void free_locked(Host_Allocator *allocator, void *memory) {
+    Allocation_Header *header = get_header(memory);
+    remove_bytes(&allocator->stats.types[header->type], header->size);
+    remove_bytes(&allocator->stats.total, header->size);
+    put_chunk(allocator, header);
+}
+
+static void *VKAPI_PTR allocation_function(void *user_data, size_t size, size_t alignment,
+                                           VkSystemAllocationScope scope) {
+    (void)scope;
+
+    Host_Allocation_Tag *tag = user_data;
+    Host_Allocator *allocator = tag->allocator;
+
+    mutex_lock(&allocator->mutex);
+    void *memory = allocate_locked(allocator, tag->type, size, alignment);
+    mutex_unlock(&allocator->mutex);
+    return memory;
+}
+
+static void *VKAPI_PTR reallocation_function(void *user_data, void *original, size_t size,
+                                             size_t alignment, VkSystemAllocationScope scope) {
+    Host_Allocation_Tag *tag = user_data;
+    Host_Allocator *allocator = tag->allocator;
+
+    if (!original) {
+        return allocation_function(user_data, size, alignment, scope);
+    }
+
+    mutex_lock(&allocator->mutex);
+
+    void *memory = NULL;
+    Allocation_Header *header = get_header(original);
+    if (size == 0) {
+        free_locked(allocator, original);
+    } else if ((uintptr_t)original % alignment == 0 &&
+               (uintptr_t)original + size <= (uintptr_t)header->chunk + header->chunk_size) {
+        /* Still fits where it is; only the accounting changes. */
+        resize_bytes(&allocator->stats.types[header->type], header->size, size);
+        resize_bytes(&allocator->stats.total, header->size, size);
+        header->size = size;
+        memory = original;
+    } else {
+        memory = allocate_locked(allocator, tag->type, size, alignment);
+        if (memory) {
+            memcpy(memory, original, header->size < size ? header->size : size);
+            free_locked(allocator, original);
+        }
+    }
+
+    mutex_unlock(&allocator->mutex);
+    return memory;
+}
+
+static void VKAPI_PTR free_function(void *user_data, void *memory) {
+    if (!memory) {
+        return;
+    }
+
+    Host_Allocation_Tag *tag = user_data;
+    Host_Allocator *allocator = tag->allocator;
+
+    mutex_lock(&allocator->mutex);
+    free_locked(allocator, memory);
+    mutex_unlock(&allocator->mutex);
+}
+
+static void VKAPI_PTR internal_allocation_notification(void *user_data, size_t size,
+                                                       VkInternalAllocationType type,
+                                                       VkSystemAllocationScope scope) {
+    (void)type;
+    (void)scope;
+
+    Host_Allocation_Tag *tag = user_data;
+    Host_Allocator *allocator = tag->allocator;
+
+    mutex_lock(&allocator->mutex);
+    allocator->stats.internal_bytes += size;
+    if (allocator->stats.internal_bytes > allocator->stats.internal_peak_bytes) {
+        allocator->stats.internal_peak_bytes = allocator->stats.internal_bytes;
+    }
+    mutex_unlock(&allocator->mutex);
+}
+
+static void VKAPI_PTR internal_free_notification(void *user_data, size_t size,
+                                                 VkInternalAllocationType type,
+                                                 VkSystemAllocationScope scope) {
+    (void)type;
+    (void)scope;
+
+    Host_Allocation_Tag *tag = user_data;
+    Host_Allocator *allocator = tag->allocator;
+
+    mutex_lock(&allocator->mutex);
+    allocator->stats.internal_bytes -= size < allocator->stats.internal_bytes
+                                           ? size
+                                           : allocator->stats.internal_bytes;
+    mutex_unlock(&allocator->mutex);
+}
+
+void init_host_allocator(Host_Allocator *allocator) {
+    assert(allocator);
+
+    *allocator = (Host_Allocator){0};
+    mutex_init(&allocator->mutex);
+
+    for (uint32_t i = 0; i < HOST_ALLOCATION_TYPE_COUNT; i++) {
+        allocator->tags[i] = (Host_Allocation_Tag){
+            .allocator = allocator,
+            .type = (Host_Allocation_Type)i,
+        };
+
+        allocator->callbacks[i] = (VkAllocationCallbacks){
+            .pUserData = &allocator->tags[i],
+            .pfnAllocation = allocation_function,
+            .pfnReallocation = reallocation_function,
+            .pfnFree = free_function,
+            .pfnInternalAllocation = internal_allocation_notification,
+            .pfnInternalFree = internal_free_notification,
+        };
+    }
+}
+
+void destroy_host_allocator(Host_Allocator *allocator) {
+    if (allocator->stats.total.current_bytes) {
+        fprintf(stderr, "Warning: %zu bytes of Vulkan host memory were never freed\n",
+                allocator->stats.total.current_bytes);
+    }
+
+    Host_Allocator_Block *block = allocator->blocks;
+    while (block) {
+        Host_Allocator_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    allocator->blocks = NULL;
+    allocator->current_block = NULL;
+    mutex_destroy(&allocator->mutex);
+}
+
+const VkAllocationCallbacks *host_allocator_callbacks(Host_Allocator *allocator,
+                                                      Host_Allocation_Type type) {
+    if (!allocator) {
+        return NULL;
+    }
+
+    assert(type < HOST_ALLOCATION_TYPE_COUNT);
+    return &allocator->callbacks[type];
+}
+
+Host_Allocator_Stats get_host_allocator_stats(Host_Allocator *allocator) {
+    mutex_lock(&allocator->mutex);
+    Host_Allocator_Stats stats = allocator->stats;
+    mutex_unlock(&allocator->mutex);
+    return stats;
+}
+
+const char *host_allocation_type_name(Host_Allocation_Type type) {
+    static const char *const names[] = {
+        [HOST_ALLOCATION_INSTANCE] = "instance",
+        [HOST_ALLOCATION_DEVICE] = "device",
+        [HOST_ALLOCATION_SHADER] = "shader",
+        [HOST_ALLOCATION_PIPELINE] = "pipeline",
+        [HOST_ALLOCATION_DESCRIPTOR] = "descriptor",
+        [HOST_ALLOCATION_COMMAND] = "command",
+        [HOST_ALLOCATION_SYNC] = "sync",
+        [HOST_ALLOCATION_IMAGE] = "image",
+        [HOST_ALLOCATION_VMA] = "vma",
+    };
+
+    return (size_t)type < ARRAY_LEN(names) ? names[type] : "unknown";
+}
+
+void print_host_allocator_stats(const Host_Allocator_Stats *stats) {
+    fprintf(stderr, "Vulkan host allocations:\n");
+    fprintf(stderr, "  %-12s %12s %12s %10s\n", "type", "current", "peak", "count");
+    for (uint32_t i = 0; i < HOST_ALLOCATION_TYPE_COUNT; i++) {
+        const Host_Allocation_Stats *type = &stats->types[i];
+        fprintf(stderr, "  %-12s %12zu %12zu %10llu\n",
+                host_allocation_type_name((Host_Allocation_Type)i), type->current_bytes,
+                type->peak_bytes, (unsigned long long)type->allocation_count);
+    }
+
+    fprintf(stderr, "  %-12s %12zu %12zu %10llu\n", "total", stats->total.current_bytes,
+            stats->total.peak_bytes, (unsigned long long)stats->total.allocation_count);
+    fprintf(stderr, "  driver-internal peak %zu bytes, %zu bytes reserved from malloc\n",
+            stats->internal_peak_bytes, stats->reserved_bytes);
+}
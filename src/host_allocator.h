@@ -0,0 +1,98 @@
+#ifndef HOST_ALLOCATOR_H
+#define HOST_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "task.h"
+
+/* What a set of callbacks is handed to. Vulkan only reports an allocation's scope, so each kind
+ * of object gets its own VkAllocationCallbacks to tell them apart.
+ */
+typedef enum Host_Allocation_Type {
+    HOST_ALLOCATION_INSTANCE,
+    HOST_ALLOCATION_DEVICE,
+    HOST_ALLOCATION_SHADER,
+    HOST_ALLOCATION_PIPELINE,
+    HOST_ALLOCATION_DESCRIPTOR,
+    HOST_ALLOCATION_COMMAND,
+    HOST_ALLOCATION_SYNC,
+    HOST_ALLOCATION_IMAGE,
+    HOST_ALLOCATION_VMA,
+    HOST_ALLOCATION_TYPE_COUNT,
+} Host_Allocation_Type;
+
+typedef struct Host_Allocation_Stats {
+    size_t current_bytes;
+    size_t peak_bytes;
+    uint64_t allocation_count;
+} Host_Allocation_Stats;
+
+typedef struct Host_Allocator_Stats {
+    Host_Allocation_Stats types[HOST_ALLOCATION_TYPE_COUNT];
+
+    /* Across all types. */
+    Host_Allocation_Stats total;
+
+    /* Driver-internal allocations reported through the notification callbacks. */
+    size_t internal_bytes;
+    size_t internal_peak_bytes;
+
+    /* Bytes obtained from malloc() for arena blocks and oversized allocations. */
+    size_t reserved_bytes;
+} Host_Allocator_Stats;
+
+typedef struct Host_Allocator_Block Host_Allocator_Block;
+typedef struct Host_Allocator Host_Allocator;
+
+typedef struct Host_Allocation_Tag {
+    Host_Allocator *allocator;
+    Host_Allocation_Type type;
+} Host_Allocation_Tag;
+
+#define HOST_ALLOCATOR_SIZE_CLASSES 15
+
+/* A per-job arena behind VkAllocationCallbacks. Small allocations are carved from large blocks and
+ * recycled through power-of-two free lists, so repeated object creation and destruction within a
+ * job does not reach the system allocator; everything is returned at once by
+ * destroy_host_allocator(). The callbacks may be invoked from any thread.
+ *
+ * The callbacks point back into the struct, so it must not be moved after init_host_allocator().
+ */
+struct Host_Allocator {
+    Mutex mutex;
+
+    /* Every block, plus the arena block chunks are currently carved from. */
+    Host_Allocator_Block *blocks;
+    Host_Allocator_Block *current_block;
+    size_t block_used;
+
+    /* Freed chunks of 2^(i + 4) bytes, 16 bytes to 256 KiB. */
+    void *free_lists[HOST_ALLOCATOR_SIZE_CLASSES];
+
+    Host_Allocation_Tag tags[HOST_ALLOCATION_TYPE_COUNT];
+    VkAllocationCallbacks callbacks[HOST_ALLOCATION_TYPE_COUNT];
+
+    Host_Allocator_Stats stats;
+};
+
+void init_host_allocator(Host_Allocator *allocator);
+void destroy_host_allocator(Host_Allocator *allocator);
+
+/* Returns the callbacks to pass when creating and destroying objects of `type`, or NULL if
+ * `allocator` is NULL so callers can pass the result straight to Vulkan.
+ */
+const VkAllocationCallbacks *host_allocator_callbacks(Host_Allocator *allocator,
+                                                      Host_Allocation_Type type);
+
+/* Copies the counters under the lock. */
+Host_Allocator_Stats get_host_allocator_stats(Host_Allocator *allocator);
+
+const char *host_allocation_type_name(Host_Allocation_Type type);
+
+/* Prints a table of current and peak bytes per type to stderr. */
+void print_host_allocator_stats(const Host_Allocator_Stats *stats);
+
+#endif /* HOST_ALLOCATOR_H */
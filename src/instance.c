@@ -0,0 +1,234 @@
+#include "instance.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "host_allocator.h"
+#include "timer.h"
+
+#define VALIDATION_LAYER_NAME "VK_LAYER_KHRONOS_validation"
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL
+vulkan_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+                      VkDebugUtilsMessageTypeFlagsEXT messageType,
+                      const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData) {
+    (void)messageType;
+    (void)pUserData;
+    if (!pCallbackData->pMessage) {
+        return VK_FALSE;
+    }
+
+    switch (messageSeverity) {
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+        fprintf(stderr, "Verbose: %s\n", pCallbackData->pMessage);
+        break;
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+        fprintf(stderr, "Info: %s\n", pCallbackData->pMessage);
+        break;
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+        fprintf(stderr, "Warning: %s\n", pCallbackData->pMessage);
+        break;
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
+        fprintf(stderr, "Error: %s\n", pCallbackData->pMessage);
+        break;
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_FLAG_BITS_MAX_ENUM_EXT:
+        break;
+    }
+
+    return VK_FALSE;
+}
+
+static bool has_instance_extension(const char *extension_name) {
+    uint32_t extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(NULL, &extension_count, NULL);
+    VkExtensionProperties *extensions = malloc(sizeof(*extensions) * extension_count);
+    vkEnumerateInstanceExtensionProperties(NULL, &extension_count, extensions);
+
+    bool found = false;
+    for (uint32_t i = 0; i < extension_count; i++) {
+        if (strcmp(extensions[i].extensionName, extension_name) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    free(extensions);
+    return found;
+}
+
+static bool has_instance_layer(const char *layer_name) {
+    uint32_t layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&layer_count, NULL);
+    VkLayerProperties *layers = malloc(sizeof(*layers) * layer_count);
+    vkEnumerateInstanceLayerProperties(&layer_count, layers);
+
+    bool found = false;
+    for (uint32_t i = 0; i < layer_count; i++) {
+        if (strcmp(layers[i].layerName, layer_name) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    free(layers);
+    return found;
+}
+
+static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
+                                             const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
+                                             const VkAllocationCallbacks *pAllocator,
+                                             VkDebugUtilsMessengerEXT *pDebugMessenger) {
+    PFN_vkCreateDebugUtilsMessengerEXT func =
+        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance,
+                                                                  "vkCreateDebugUtilsMessengerEXT");
+    if (func) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    }
+
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+}
+
+static void DestroyDebugUtilsMessengerEXT(VkInstance instance,
+                                          VkDebugUtilsMessengerEXT debugMessenger,
+                                          const VkAllocationCallbacks *pAllocator) {
+    PFN_vkDestroyDebugUtilsMessengerEXT func =
+        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+            instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func) {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+static uint32_t get_loader_api_version(void) {
+    /* vkEnumerateInstanceVersion() does not exist on 1.0 loaders. */
+    PFN_vkEnumerateInstanceVersion enumerate_instance_version =
+        (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+
+    uint32_t version = VK_API_VERSION_1_0;
+    if (enumerate_instance_version && enumerate_instance_version(&version) != VK_SUCCESS) {
+        version = VK_API_VERSION_1_0;
+    }
+
+    return version;
+}
+
+bool create_instance(const Instance_Info *info, Instance *instance) {
+    assert(info);
+    assert(instance);
+
+    uint64_t start_ns = timer_now_ns();
+    *instance = (Instance){
+        .allocation_callbacks =
+            host_allocator_callbacks(info->host_allocator, HOST_ALLOCATION_INSTANCE),
+    };
+
+    /* A 1.0 loader rejects any other apiVersion; newer loaders accept 1.3 and the effective
+     * version becomes the lower of the loader's and each device's.
+     */
+    uint32_t loader_version = get_loader_api_version();
+    uint32_t requested_version =
+        loader_version >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_3 : VK_API_VERSION_1_0;
+    instance->api_version =
+        loader_version < requested_version ? loader_version : requested_version;
+
+    const VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "Calyko",
+        .applicationVersion = VK_MAKE_API_VERSION(0, 0, 1, 0),
+        .apiVersion = requested_version,
+    };
+
+    const char *extensions[1];
+    uint32_t extension_count = 0;
+
+    const char *layers[1];
+    uint32_t layer_count = 0;
+
+    /* The release path never enumerates layers or extensions; the loader only has to find the
+     * ICDs.
+     */
+    if (info->validation) {
+        if (has_instance_extension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) {
+            extensions[extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+            instance->debug_utils_enabled = true;
+        } else {
+            fprintf(stderr, "Warning: %s is not available, debug messages are disabled\n",
+                    VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        }
+
+        if (has_instance_layer(VALIDATION_LAYER_NAME)) {
+            layers[layer_count++] = VALIDATION_LAYER_NAME;
+            instance->validation_enabled = true;
+        } else {
+            fprintf(stderr, "Warning: %s is not installed, validation is disabled\n",
+                    VALIDATION_LAYER_NAME);
+        }
+    }
+
+    VkDebugUtilsMessageSeverityFlagsEXT severity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                                   VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (info->verbose) {
+        severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+
+    const VkDebugUtilsMessengerCreateInfoEXT debug_info = {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+        .messageSeverity = severity,
+        .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                       VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                       VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+        .pfnUserCallback = &vulkan_debug_callback,
+    };
+
+    const VkInstanceCreateInfo instance_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+        .ppEnabledExtensionNames = extensions,
+        .enabledExtensionCount = extension_count,
+        .ppEnabledLayerNames = layers,
+        .enabledLayerCount = layer_count,
+        .pNext = instance->debug_utils_enabled ? &debug_info : NULL,
+    };
+
+    VkResult result = vkCreateInstance(&instance_info, instance->allocation_callbacks,
+                                       &instance->instance);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateInstance() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    if (instance->debug_utils_enabled) {
+        result = CreateDebugUtilsMessengerEXT(instance->instance, &debug_info,
+                                              instance->allocation_callbacks, &instance->messenger);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "vkCreateDebugUtilsMessengerEXT() failed: %s\n",
+                    string_VkResult(result));
+            return false;
+        }
+    }
+
+    instance->creation_ms = timer_ms_between(start_ns, timer_now_ns());
+    if (info->verbose) {
+        fprintf(stderr, "Instance created in %.3f ms (validation %s, debug utils %s)\n",
+                instance->creation_ms, instance->validation_enabled ? "on" : "off",
+                instance->debug_utils_enabled ? "on" : "off");
+    }
+
+    return true;
+}
+
+void destroy_instance(Instance *instance) {
+    if (instance->messenger) {
+        DestroyDebugUtilsMessengerEXT(instance->instance, instance->messenger,
+                                      instance->allocation_callbacks);
+    }
+
+    vkDestroyInstance(instance->instance, instance->allocation_callbacks);
+}
@@ -0,0 +1,43 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "host_allocator.h"
+
+typedef struct Instance_Info {
+    /* Requests VK_LAYER_KHRONOS_validation and VK_EXT_debug_utils. Either one is skipped with a
+     * warning when it is not installed. When false, a bare instance is created.
+     */
+    bool validation;
+
+    /* Forwards VERBOSE and INFO messages to stderr in addition to warnings and errors. */
+    bool verbose;
+
+    /* Optional; tracks the instance's and debug messenger's host allocations. */
+    Host_Allocator *host_allocator;
+} Instance_Info;
+
+typedef struct Instance {
+    VkInstance instance;
+    VkDebugUtilsMessengerEXT messenger;
+
+    /* Passed to every instance-level create and destroy call; NULL without a host allocator. */
+    const VkAllocationCallbacks *allocation_callbacks;
+
+    /* Highest core version usable with this instance: the loader's version capped at 1.3. */
+    uint32_t api_version;
+
+    bool validation_enabled;
+    bool debug_utils_enabled;
+
+    /* Wall time spent in create_instance(), including layer and extension enumeration. */
+    double creation_ms;
+} Instance;
+
+bool create_instance(const Instance_Info *info, Instance *instance);
+void destroy_instance(Instance *instance);
+
+#endif /* INSTANCE_H */
@@ -0,0 +1,410 @@
+#include "job_graph.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "host_allocator.h"
+
+static VkSemaphore create_semaphore(const Device *device,
+                                    const VkAllocationCallbacks *allocation_callbacks,
+                                    VkSemaphoreType type) {
+    const VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = type,
+        .initialValue = 0,
+    };
+
+    /* Binary semaphores are created without the struct so this also works on 1.0 devices. */
+    const VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = type == VK_SEMAPHORE_TYPE_TIMELINE ? &type_info : NULL,
+    };
+
+    VkSemaphore semaphore;
+    VkResult result = device->fn.vkCreateSemaphore(device->device, &semaphore_info,
+                                                   allocation_callbacks, &semaphore);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateSemaphore() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return semaphore;
+}
+
+static VkFence create_fence(VkDevice device, const VkAllocationCallbacks *allocation_callbacks) {
+    const VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+
+    VkFence fence;
+    VkResult result = vkCreateFence(device, &fence_info, allocation_callbacks, &fence);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateFence() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return fence;
+}
+
+static const VkAllocationCallbacks *sync_callbacks(const Job_Graph *graph) {
+    return host_allocator_callbacks(graph->device->host_allocator, HOST_ALLOCATION_SYNC);
+}
+
+bool create_job_graph(const Device *device, Job_Graph *graph) {
+    assert(device);
+    assert(graph);
+
+    *graph = (Job_Graph){
+        .device = device,
+        .timeline = device->info.features.timeline_semaphore,
+    };
+
+    VkDevice vk_device = device->device;
+    const VkAllocationCallbacks *allocation_callbacks = sync_callbacks(graph);
+
+    for (uint32_t i = 0; i < JOB_LANE_COUNT; i++) {
+        Job_Lane_State *lane = &graph->lanes[i];
+
+        if (graph->timeline) {
+            lane->timeline =
+                create_semaphore(device, allocation_callbacks, VK_SEMAPHORE_TYPE_TIMELINE);
+            if (!lane->timeline) {
+                fprintf(stderr, "create_semaphore() failed\n");
+                return false;
+            }
+
+            continue;
+        }
+
+        /* Host jobs have nothing to signal without a timeline. */
+        if (i == JOB_LANE_HOST) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < JOB_GRAPH_FALLBACK_SIGNALS; j++) {
+            Job_Signal *signal = &lane->signals[j];
+
+            signal->fence = create_fence(vk_device, allocation_callbacks);
+            signal->semaphore =
+                create_semaphore(device, allocation_callbacks, VK_SEMAPHORE_TYPE_BINARY);
+            if (!signal->fence || !signal->semaphore) {
+                fprintf(stderr, "Failed to create job signal\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void destroy_job_graph(Job_Graph *graph) {
+    const Device *device = graph->device;
+    const VkAllocationCallbacks *allocation_callbacks = sync_callbacks(graph);
+
+    for (uint32_t i = 0; i < JOB_LANE_COUNT; i++) {
+        Job_Lane_State *lane = &graph->lanes[i];
+
+        for (uint32_t j = 0; j < JOB_GRAPH_FALLBACK_SIGNALS; j++) {
+            device->fn.vkDestroySemaphore(device->device, lane->signals[j].semaphore,
+                                          allocation_callbacks);
+            vkDestroyFence(device->device, lane->signals[j].fence, allocation_callbacks);
+        }
+
+        device->fn.vkDestroySemaphore(device->device, lane->timeline, allocation_callbacks);
+    }
+}
+
+static void mark_completed(Job_Lane_State *lane, uint64_t value) {
+    /* Jobs on a lane complete in order, so reaching `value` implies every earlier value. */
+    if (value > lane->completed) {
+        lane->completed = value;
+    }
+}
+
+static bool wait_for_signal(const Job_Graph *graph, Job_Lane_State *lane,
+                            const Job_Signal *signal) {
+    const Device *device = graph->device;
+
+    VkResult result =
+        device->fn.vkWaitForFences(device->device, 1, &signal->fence, VK_TRUE, UINT64_MAX);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkWaitForFences() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    mark_completed(lane, signal->value);
+    return true;
+}
+
+/* Waits for the job that last used `signal` so it can be signalled again. */
+static bool recycle_signal(const Job_Graph *graph, Job_Lane_State *lane, Job_Signal *signal) {
+    const Device *device = graph->device;
+
+    if (!signal->pending) {
+        return true;
+    }
+
+    if (!wait_for_signal(graph, lane, signal)) {
+        return false;
+    }
+
+    VkResult result = device->fn.vkResetFences(device->device, 1, &signal->fence);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkResetFences() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    /* A binary semaphore nobody waited on stays signalled and cannot be signalled again. */
+    if (!signal->semaphore_waited) {
+        const VkAllocationCallbacks *allocation_callbacks = sync_callbacks(graph);
+
+        device->fn.vkDestroySemaphore(device->device, signal->semaphore, allocation_callbacks);
+        signal->semaphore =
+            create_semaphore(device, allocation_callbacks, VK_SEMAPHORE_TYPE_BINARY);
+        if (!signal->semaphore) {
+            fprintf(stderr, "create_semaphore() failed\n");
+            return false;
+        }
+    }
+
+    signal->pending = false;
+    return true;
+}
+
+static Job_Signal *find_signal(Job_Lane_State *lane, uint64_t value) {
+    Job_Signal *signal = &lane->signals[value % JOB_GRAPH_FALLBACK_SIGNALS];
+    assert(signal->pending);
+    assert(signal->value == value);
+    return signal;
+}
+
+bool submit_job(Job_Graph *graph, const Job_Desc *desc, Job_Point *out_point) {
+    assert(graph);
+    assert(desc);
+    assert(desc->lane != JOB_LANE_HOST);
+    assert(desc->wait_count <= JOB_MAX_WAITS);
+    assert(out_point);
+
+    const Device *device = graph->device;
+    Job_Lane_State *lane = &graph->lanes[desc->lane];
+    uint64_t value = lane->submitted + 1;
+
+    VkSemaphore wait_semaphores[JOB_MAX_WAITS];
+    uint64_t wait_values[JOB_MAX_WAITS];
+    VkPipelineStageFlags wait_stages[JOB_MAX_WAITS];
+    uint32_t wait_count = 0;
+
+    for (uint32_t i = 0; i < desc->wait_count; i++) {
+        Job_Point point = desc->waits[i];
+        Job_Lane_State *source = &graph->lanes[point.lane];
+        assert(point.value <= source->submitted);
+
+        if (point.value <= source->completed) {
+            continue;
+        }
+
+        if (graph->timeline) {
+            wait_semaphores[wait_count] = source->timeline;
+            wait_values[wait_count] = point.value;
+            wait_stages[wait_count] = desc->wait_stages[i];
+            wait_count++;
+            continue;
+        }
+
+        if (point.lane == JOB_LANE_HOST) {
+            fprintf(stderr, "Host job %llu must complete before jobs waiting on it are submitted\n",
+                    (unsigned long long)point.value);
+            return false;
+        }
+
+        /* A binary semaphore can only be waited on once; later waiters fall back to the fence. */
+        Job_Signal *signal = find_signal(source, point.value);
+        if (signal->semaphore_waited) {
+            if (!wait_for_signal(graph, source, signal)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        signal->semaphore_waited = true;
+        wait_semaphores[wait_count] = signal->semaphore;
+        wait_values[wait_count] = 0;
+        wait_stages[wait_count] = desc->wait_stages[i];
+        wait_count++;
+    }
+
+    VkSemaphore signal_semaphore = lane->timeline;
+    VkFence fence = VK_NULL_HANDLE;
+    Job_Signal *signal = NULL;
+
+    if (!graph->timeline) {
+        signal = &lane->signals[value % JOB_GRAPH_FALLBACK_SIGNALS];
+        if (!recycle_signal(graph, lane, signal)) {
+            return false;
+        }
+
+        signal_semaphore = signal->semaphore;
+        fence = signal->fence;
+    }
+
+    const VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pWaitSemaphoreValues = wait_values,
+        .waitSemaphoreValueCount = wait_count,
+        .pSignalSemaphoreValues = &value,
+        .signalSemaphoreValueCount = 1,
+    };
+
+    const VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = graph->timeline ? &timeline_info : NULL,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stages,
+        .waitSemaphoreCount = wait_count,
+        .pCommandBuffers = desc->command_buffers,
+        .commandBufferCount = desc->command_buffer_count,
+        .pSignalSemaphores = &signal_semaphore,
+        .signalSemaphoreCount = 1,
+    };
+
+    VkResult result = device->fn.vkQueueSubmit(desc->queue, 1, &submit_info, fence);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkQueueSubmit() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    if (signal) {
+        signal->value = value;
+        signal->pending = true;
+        signal->semaphore_waited = false;
+    }
+
+    lane->submitted = value;
+    *out_point = (Job_Point){
+        .lane = desc->lane,
+        .value = value,
+    };
+
+    return true;
+}
+
+Job_Point begin_host_job(Job_Graph *graph) {
+    assert(graph);
+
+    Job_Lane_State *lane = &graph->lanes[JOB_LANE_HOST];
+    lane->submitted++;
+
+    return (Job_Point){
+        .lane = JOB_LANE_HOST,
+        .value = lane->submitted,
+    };
+}
+
+bool complete_host_job(Job_Graph *graph, Job_Point point) {
+    assert(graph);
+    assert(point.lane == JOB_LANE_HOST);
+
+    Job_Lane_State *lane = &graph->lanes[JOB_LANE_HOST];
+    assert(point.value == lane->completed + 1);
+    assert(point.value <= lane->submitted);
+
+    if (graph->timeline) {
+        const VkSemaphoreSignalInfo signal_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+            .semaphore = lane->timeline,
+            .value = point.value,
+        };
+
+        const Device *device = graph->device;
+        VkResult result = device->fn.vkSignalSemaphore(device->device, &signal_info);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "vkSignalSemaphore() failed: %s\n", string_VkResult(result));
+            return false;
+        }
+    }
+
+    lane->completed = point.value;
+    return true;
+}
+
+bool wait_for_job(Job_Graph *graph, Job_Point point) {
+    assert(graph);
+
+    const Device *device = graph->device;
+    Job_Lane_State *lane = &graph->lanes[point.lane];
+    assert(point.value <= lane->submitted);
+
+    if (point.value <= lane->completed) {
+        return true;
+    }
+
+    if (!graph->timeline) {
+        /* Nothing else could complete a host job while this thread waits for it. */
+        assert(point.lane != JOB_LANE_HOST);
+        return wait_for_signal(graph, lane, find_signal(lane, point.value));
+    }
+
+    const VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pSemaphores = &lane->timeline,
+        .pValues = &point.value,
+        .semaphoreCount = 1,
+    };
+
+    VkResult result = device->fn.vkWaitSemaphores(device->device, &wait_info, UINT64_MAX);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkWaitSemaphores() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    mark_completed(lane, point.value);
+    return true;
+}
+
+bool is_job_complete(Job_Graph *graph, Job_Point point, bool *out_complete) {
+    assert(graph);
+    assert(out_complete);
+
+    const Device *device = graph->device;
+    Job_Lane_State *lane = &graph->lanes[point.lane];
+
+    *out_complete = point.value <= lane->completed;
+    if (*out_complete || point.lane == JOB_LANE_HOST) {
+        return true;
+    }
+
+    if (graph->timeline) {
+        uint64_t counter;
+        VkResult result =
+            device->fn.vkGetSemaphoreCounterValue(device->device, lane->timeline, &counter);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "vkGetSemaphoreCounterValue() failed: %s\n", string_VkResult(result));
+            return false;
+        }
+
+        mark_completed(lane, counter);
+        *out_complete = point.value <= counter;
+        return true;
+    }
+
+    const Job_Signal *signal = find_signal(lane, point.value);
+    VkResult result = device->fn.vkGetFenceStatus(device->device, signal->fence);
+    if (result == VK_NOT_READY) {
+        return true;
+    }
+
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkGetFenceStatus() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    mark_completed(lane, point.value);
+    *out_complete = true;
+    return true;
+}
@@ -0,0 +1,113 @@
+#ifndef JOB_GRAPH_H
+#define JOB_GRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+/* Streams of jobs that complete in submission order: one per queue, plus the host. */
+typedef enum Job_Lane {
+    JOB_LANE_COMPUTE,
+    JOB_LANE_TRANSFER,
+    JOB_LANE_HOST,
+    JOB_LANE_COUNT,
+} Job_Lane;
+
+/* Reached once `lane` has completed the job that was assigned `value`. Values start at 1, so a
+ * zero-initialised point is always reached.
+ */
+typedef struct Job_Point {
+    Job_Lane lane;
+    uint64_t value;
+} Job_Point;
+
+#define JOB_MAX_WAITS 4
+
+/* A batch of command buffers submitted to `queue` as the next job of `lane`. */
+typedef struct Job_Desc {
+    Job_Lane lane;
+    VkQueue queue;
+
+    const VkCommandBuffer *command_buffers;
+    uint32_t command_buffer_count;
+
+    /* Points that must be reached before `wait_stages[i]` of the job may start. Points on the host
+     * lane may be waited on before the host has completed them, but only with timeline
+     * semaphores.
+     */
+    Job_Point waits[JOB_MAX_WAITS];
+    VkPipelineStageFlags wait_stages[JOB_MAX_WAITS];
+    uint32_t wait_count;
+} Job_Desc;
+
+/* Submitted GPU jobs tracked at once per lane without timeline semaphores. Submitting more waits
+ * on the host for the oldest one.
+ */
+#define JOB_GRAPH_FALLBACK_SIGNALS 8
+
+/* Without timeline semaphores, every GPU job signals a fence for host waits and a binary semaphore
+ * for the first GPU job that waits on it.
+ */
+typedef struct Job_Signal {
+    uint64_t value;
+    VkFence fence;
+    VkSemaphore semaphore;
+
+    bool pending;
+    bool semaphore_waited;
+} Job_Signal;
+
+typedef struct Job_Lane_State {
+    /* Timeline semaphore whose counter is the lane's completed value, or VK_NULL_HANDLE. */
+    VkSemaphore timeline;
+
+    /* The last value handed out and the last value known to be reached. */
+    uint64_t submitted;
+    uint64_t completed;
+
+    Job_Signal signals[JOB_GRAPH_FALLBACK_SIGNALS];
+} Job_Lane_State;
+
+/* Orders GPU submissions and host work across queues without round trips through the host.
+ *
+ * With Device_Features.timeline_semaphore, each lane owns one timeline semaphore that every job
+ * on it signals with its value, so any job can wait on any point and the host can wait for
+ * exactly the value it needs. Host jobs signal from the CPU, which lets GPU work waiting on them
+ * be submitted before they finish.
+ *
+ * On older devices the same calls fall back to a binary semaphore and fence per GPU job. A point
+ * can then be waited on by one GPU job directly; later GPU waiters and waits on host jobs are
+ * resolved on the host at submission time, so host jobs must be completed before any GPU job
+ * that depends on them is submitted.
+ */
+typedef struct Job_Graph {
+    const Device *device;
+    bool timeline;
+    Job_Lane_State lanes[JOB_LANE_COUNT];
+} Job_Graph;
+
+bool create_job_graph(const Device *device, Job_Graph *graph);
+
+/* Every submitted job must have completed. */
+void destroy_job_graph(Job_Graph *graph);
+
+/* Submits `desc` after its waits and returns the point it signals in `out_point`. */
+bool submit_job(Job_Graph *graph, const Job_Desc *desc, Job_Point *out_point);
+
+/* Reserves the next host job. GPU jobs may depend on it before complete_host_job() is called. */
+Job_Point begin_host_job(Job_Graph *graph);
+
+/* Completes a host job from begin_host_job(). Host jobs complete in the order they were begun. */
+bool complete_host_job(Job_Graph *graph, Job_Point point);
+
+/* Blocks until `point` has been reached. */
+bool wait_for_job(Job_Graph *graph, Job_Point point);
+
+/* Sets `out_complete` to whether `point` has been reached, without blocking. Returns false if
+ * the device could not be queried.
+ */
+bool is_job_complete(Job_Graph *graph, Job_Point point, bool *out_complete);
+
+#endif /* JOB_GRAPH_H */
@@ -9,677 +9,907 @@
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan.h>
 
+#include "autotune.h"
 #include "device.h"
+#include "host_allocator.h"
+#include "instance.h"
+#include "options.h"
 #include "pipeline.h"
+#include "pipeline_cache.h"
+#include "profile.h"
+#include "readback.h"
+#include "renderer.h"
+#include "sequence.h"
+#include "shader.h"
+#include "shaders.h"
+#include "task.h"
+#include "tile_writer.h"
+#include "timer.h"
 #include "utils.h"
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL
-vulkan_debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-                      VkDebugUtilsMessageTypeFlagsEXT messageType,
-                      const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData) {
-    (void)messageType;
-    (void)pUserData;
-    if (!pCallbackData->pMessage) {
-        return VK_FALSE;
-    }
-
-    switch (messageSeverity) {
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-        fprintf(stderr, "Verbose: %s\n", pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-        fprintf(stderr, "Info: %s\n", pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-        fprintf(stderr, "Warning: %s\n", pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-        fprintf(stderr, "Error: %s\n", pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_FLAG_BITS_MAX_ENUM_EXT:
-        break;
-    }
-
-    return VK_FALSE;
-}
+static VmaAllocator create_vma_allocator(VkInstance instance, const Device *device) {
+    const Physical_Device_Info *info = &device->info;
 
-static bool has_extension(const VkExtensionProperties *extensions, uint32_t extension_count,
-                          const char *extension_name) {
-    for (uint32_t i = 0; i < extension_count; i++) {
-        if (strcmp(extensions[i].extensionName, extension_name) == 0) {
-            return true;
-        }
+    VmaAllocatorCreateFlags flags = 0;
+    if (info->features.buffer_device_address) {
+        flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
     }
-    return false;
-}
 
-static bool has_required_extensions(const char **required, uint32_t required_count) {
-    uint32_t extension_count = 0;
-    vkEnumerateInstanceExtensionProperties(NULL, &extension_count, NULL);
-    VkExtensionProperties *extensions = malloc(sizeof(*extensions) * extension_count);
-    vkEnumerateInstanceExtensionProperties(NULL, &extension_count, extensions);
+    const VmaAllocatorCreateInfo vma_allocator_info = {
+        .flags = flags,
+        .vulkanApiVersion = info->api_version,
+        .physicalDevice = info->physical_device,
+        .device = device->device,
+        .instance = instance,
+        .pAllocationCallbacks =
+            host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_VMA),
+    };
 
-    for (uint32_t i = 0; i < required_count; i++) {
-        if (!has_extension(extensions, extension_count, required[i])) {
-            fprintf(stderr, "Missing extension: %s\n", required[i]);
-            free(extensions);
-            return false;
-        }
+    VmaAllocator allocator;
+    VkResult result = vmaCreateAllocator(&vma_allocator_info, &allocator);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateAllocator() failed: %s\n", string_VkResult(result));
+        return NULL;
     }
 
-    free(extensions);
-    return true;
-}
-
-static bool has_layer(const VkLayerProperties *layers, uint32_t layer_count,
-                      const char *layer_name) {
-    for (uint32_t i = 0; i < layer_count; i++) {
-        if (strcmp(layers[i].layerName, layer_name) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return allocator;
 }
 
-static bool has_required_layers(const char **required, uint32_t required_count) {
-    uint32_t layer_count = 0;
-    vkEnumerateInstanceLayerProperties(&layer_count, NULL);
-    VkLayerProperties *layers = malloc(sizeof(*layers) * layer_count);
-    vkEnumerateInstanceLayerProperties(&layer_count, layers);
-
-    for (uint32_t i = 0; i < required_count; i++) {
-        if (!has_layer(layers, layer_count, required[i])) {
-            fprintf(stderr, "Missing layer: %s\n", required[i]);
-            free(layers);
-            return false;
-        }
-    }
+/* The path tracing kernels are loaded by create_pathtracing_pipeline(). */
+static VkShaderModule create_pack_shader(const Device *device, const Options *options) {
+    const Shader_Source pack_source = {
+        .name = "pack.comp.spv",
+        .code = pack_comp_spv,
+        .size = pack_comp_spv_size,
+    };
 
-    free(layers);
-    return true;
+    return create_shader_module(
+        device->device, host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_SHADER),
+        &pack_source, options->shader_dir);
 }
 
-static VkInstance create_instance(const VkDebugUtilsMessengerCreateInfoEXT *debug_info) {
-    assert(debug_info);
+/* State owned by the pipeline task. The main thread only reads it after task_wait(). */
+typedef struct Pipeline_Build {
+    const Device *device;
+    const Options *options;
+    Pathtracing_Constants constants;
+    Readback_Layout readback;
 
-    const VkApplicationInfo app_info = {
-        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .pApplicationName = "Calyko",
-        .applicationVersion = VK_MAKE_API_VERSION(0, 0, 1, 0),
-        .apiVersion = VK_API_VERSION_1_0,
-    };
+    /* Zero when previews are off. */
+    uint32_t preview_scale;
+    Readback_Layout preview;
 
-    const char *extensions[] = {
-        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-    };
+    Profile profile;
+    VkShaderModule pack_shader;
+    Pipeline_Cache pipeline_cache;
+    Pathtracing_Pipeline pipeline;
+    Pack_Pipeline pack_pipeline;
+    Pack_Pipeline preview_pipeline;
+} Pipeline_Build;
 
-    const char *layers[] = {
-        "VK_LAYER_KHRONOS_validation",
-    };
+static bool build_pipeline(void *arg) {
+    Pipeline_Build *build = arg;
+    const Device *device = build->device;
+    const Options *options = build->options;
 
-    if (!has_required_extensions(extensions, ARRAY_LEN(extensions))) {
-        fprintf(stderr, "Missing required extensions\n");
-        return NULL;
+    profile_init(&build->profile);
+
+    profile_begin(&build->profile, "shader");
+    build->pack_shader = create_pack_shader(device, options);
+    if (!build->pack_shader) {
+        fprintf(stderr, "create_pack_shader() failed\n");
+        return false;
     }
+    profile_end(&build->profile);
 
-    if (!has_required_layers(layers, ARRAY_LEN(layers))) {
-        fprintf(stderr, "Missing required layers\n");
-        return NULL;
+    profile_begin(&build->profile, "pipeline_cache_load");
+    if (!create_pipeline_cache(device, options->pipeline_cache_path, &build->pipeline_cache)) {
+        fprintf(stderr, "create_pipeline_cache() failed\n");
+        return false;
     }
+    profile_end(&build->profile);
 
-    const VkInstanceCreateInfo instance_info = {
-        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-        .pApplicationInfo = &app_info,
-        .ppEnabledExtensionNames = extensions,
-        .enabledExtensionCount = ARRAY_LEN(extensions),
-        .ppEnabledLayerNames = layers,
-        .enabledLayerCount = ARRAY_LEN(layers),
-        .pNext = debug_info,
+    const Pathtracing_Pipeline_Info pipeline_info = {
+        .shader_dir = options->shader_dir,
+        .constants = build->constants,
+        .pipeline_cache = build->pipeline_cache.cache,
     };
 
-    VkInstance instance = NULL;
-    VkResult result = vkCreateInstance(&instance_info, NULL, &instance);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateInstance() failed: %s\n", string_VkResult(result));
-        return NULL;
+    profile_begin(&build->profile, "pipeline");
+    if (!create_pathtracing_pipeline(device, &pipeline_info, &build->pipeline)) {
+        fprintf(stderr, "create_pathtracing_pipeline() failed\n");
+        return false;
     }
 
-    return instance;
-}
+    if (!create_pack_pipeline(device, build->pack_shader, build->pipeline_cache.cache,
+                              &build->readback, 1, &build->pack_pipeline)) {
+        fprintf(stderr, "create_pack_pipeline() failed\n");
+        return false;
+    }
 
-static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
-                                             const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
-                                             const VkAllocationCallbacks *pAllocator,
-                                             VkDebugUtilsMessengerEXT *pDebugMessenger) {
-    PFN_vkCreateDebugUtilsMessengerEXT func =
-        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance,
-                                                                  "vkCreateDebugUtilsMessengerEXT");
-    if (func) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    if (build->preview_scale &&
+        !create_pack_pipeline(device, build->pack_shader, build->pipeline_cache.cache,
+                              &build->preview, build->preview_scale, &build->preview_pipeline)) {
+        fprintf(stderr, "create_pack_pipeline() failed\n");
+        return false;
     }
+    profile_end(&build->profile);
 
-    return VK_ERROR_EXTENSION_NOT_PRESENT;
+    return true;
 }
 
-static void DestroyDebugUtilsMessengerEXT(VkInstance instance,
-                                          VkDebugUtilsMessengerEXT debugMessenger,
-                                          const VkAllocationCallbacks *pAllocator) {
-    PFN_vkDestroyDebugUtilsMessengerEXT func =
-        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
-            instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func) {
-        func(instance, debugMessenger, pAllocator);
+/* Size and passes of the frames --autotune times each workgroup size with. */
+#define AUTOTUNE_SIZE 512
+#define AUTOTUNE_PASSES 4
+
+/* Sweeps workgroup sizes on the scene `constants` describe, with resources of its own that are
+ * gone before the render is set up. The pipeline cache is saved, so the render compiles the winner
+ * from it.
+ */
+static bool tune_workgroup_sizes(const Instance *instance, const Device *device,
+                                 const Options *options, const Pathtracing_Constants *constants,
+                                 Workgroup_Tuning *out_tuning) {
+    VmaAllocator allocator = create_vma_allocator(instance->instance, device);
+    if (!allocator) {
+        fprintf(stderr, "create_vma_allocator() failed\n");
+        return false;
     }
-}
 
-static VkDebugUtilsMessengerEXT create_debug_messenger(
-    VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *debug_info) {
-    VkDebugUtilsMessengerEXT messenger;
-    VkResult result = CreateDebugUtilsMessengerEXT(instance, debug_info, NULL, &messenger);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateDebugUtilsMessengerEXT() failed: %s\n", string_VkResult(result));
-        return NULL;
+    VkShaderModule pack_shader = create_pack_shader(device, options);
+    if (!pack_shader) {
+        fprintf(stderr, "create_pack_shader() failed\n");
+        return false;
     }
 
-    return messenger;
-}
-
-static uint32_t *read_spirv_file(const char *filename, uint32_t *word_count) {
-    *word_count = 0;
-
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        perror(filename);
-        return NULL;
+    Pipeline_Cache pipeline_cache;
+    if (!create_pipeline_cache(device, options->pipeline_cache_path, &pipeline_cache)) {
+        fprintf(stderr, "create_pipeline_cache() failed\n");
+        return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    size_t file_size = (size_t)ftell(file);
-    rewind(file);
+    const Autotune_Info autotune_info = {
+        .shader_dir = options->shader_dir,
+        .pack_shader = pack_shader,
+        .pipeline_cache = pipeline_cache.cache,
+        .constants = *constants,
+        .width = AUTOTUNE_SIZE,
+        .height = AUTOTUNE_SIZE,
+        .passes = AUTOTUNE_PASSES,
+        .verbose = options->verbose,
+    };
 
-    if (file_size % 4 != 0) {
-        fprintf(stderr, "SPIR-V file size is not a multiple of 4: %d bytes\n", file_size);
-        fclose(file);
-        return NULL;
+    bool tuned = autotune_workgroup_sizes(device, allocator, &autotune_info, out_tuning);
+    if (!tuned) {
+        fprintf(stderr, "autotune_workgroup_sizes() failed\n");
     }
 
-    size_t num_words = file_size / 4;
-    uint32_t *words = malloc(num_words * sizeof(uint32_t));
-    if (!words) {
-        perror("malloc failed");
-        fclose(file);
-        return NULL;
+    if (!save_pipeline_cache(device, &pipeline_cache)) {
+        fprintf(stderr, "Warning: save_pipeline_cache() failed\n");
     }
 
-    if (fread(words, sizeof(uint32_t), num_words, file) != num_words) {
-        perror("fread failed");
-        free(words);
-        fclose(file);
-        return NULL;
-    }
+    destroy_pipeline_cache(device, &pipeline_cache);
+    vkDestroyShaderModule(device->device, pack_shader,
+                          host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_SHADER));
+    vmaDestroyAllocator(allocator);
+    return tuned;
+}
 
-    fclose(file);
-    *word_count = num_words;
-    return words;
+/* Host time spent on finished frames, and the file tiled frames are being written to. */
+typedef struct Frame_Writer {
+    uint32_t frame_count;
+
+    /* Renderer frames per output frame, in rows of `tiles_x`; one when not tiling. */
+    uint32_t tiles_x;
+    uint32_t tile_count;
+    uint32_t output_width;
+    uint32_t output_height;
+
+    char tile_path[32];
+    Tile_Writer tile_writer;
+
+    uint64_t wait_ns;
+    uint64_t write_ns;
+    uint64_t preview_ns;
+
+    /* Time between the completion of consecutive output frames; the first is counted from the
+     * start of the frame loop. With frames pipelined, this is the time each frame adds.
+     */
+    uint64_t last_frame_end_ns;
+    uint64_t frame_min_ns;
+    uint64_t frame_max_ns;
+    bool verbose;
+} Frame_Writer;
+
+static void tile_origin(const Renderer *renderer, const Frame_Writer *writer, uint32_t tile,
+                        uint32_t *out_x, uint32_t *out_y) {
+    *out_x = tile % writer->tiles_x * renderer->info.width;
+    *out_y = tile / writer->tiles_x * renderer->info.height;
 }
 
-static VkShaderModule load_shader_module(VkDevice device, const char *filename) {
-    uint32_t word_count;
-    uint32_t *code = read_spirv_file(filename, &word_count);
-    if (!code) {
-        fprintf(stderr, "read_file_bytes failed\n");
-        return VK_NULL_HANDLE;
+/* Streams one tile of a frame into its PPM, opening the file on the first tile and closing it
+ * after the last.
+ */
+static bool write_tile_frame(const Renderer *renderer, uint32_t frame_index, Frame_Writer *writer) {
+    uint32_t frame = frame_index / writer->tile_count;
+    uint32_t tile = frame_index % writer->tile_count;
+
+    if (tile == 0) {
+        if (writer->frame_count == 1) {
+            snprintf(writer->tile_path, sizeof(writer->tile_path), "output.ppm");
+        } else {
+            snprintf(writer->tile_path, sizeof(writer->tile_path), "output_%04u.ppm", frame);
+        }
+
+        if (!open_tile_writer(writer->tile_path, writer->output_width, writer->output_height,
+                              &writer->tile_writer)) {
+            fprintf(stderr, "open_tile_writer() failed\n");
+            return false;
+        }
     }
 
-    const VkShaderModuleCreateInfo shader_module_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pCode = code,
-        .codeSize = word_count * sizeof(uint32_t),
-    };
+    uint32_t x;
+    uint32_t y;
+    tile_origin(renderer, writer, tile, &x, &y);
 
-    VkShaderModule shader_module;
-    VkResult result = vkCreateShaderModule(device, &shader_module_info, NULL, &shader_module);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateShaderModule failed: %s\n", string_VkResult(result));
-        free(code);
-        return VK_NULL_HANDLE;
+    uint32_t width = renderer->info.width;
+    uint32_t height = renderer->info.height;
+    if (width > writer->output_width - x) {
+        width = writer->output_width - x;
     }
 
-    free(code);
-    return shader_module;
-}
+    if (height > writer->output_height - y) {
+        height = writer->output_height - y;
+    }
 
-static VkDescriptorPool create_descriptor_pool(VkDevice device) {
-    const VkDescriptorPoolCreateInfo descriptor_pool_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = 1,
-        .pPoolSizes =
-            &(VkDescriptorPoolSize){
-                .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                .descriptorCount = 1,
-            },
-        .poolSizeCount = 1,
-    };
+    /* Tiled frames are read back as rgb8, so rows go to the file as they are. */
+    const uint8_t *data = get_frame_pixels(renderer, frame_index);
+    if (!write_tile(&writer->tile_writer, x, y, width, height, data,
+                    renderer->info.readback.row_pitch)) {
+        fprintf(stderr, "write_tile() failed\n");
+        return false;
+    }
 
-    VkDescriptorPool descriptor_pool;
-    VkResult result = vkCreateDescriptorPool(device, &descriptor_pool_info, NULL, &descriptor_pool);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateDescriptorPool() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+    if (tile + 1 == writer->tile_count && !close_tile_writer(&writer->tile_writer)) {
+        fprintf(stderr, "close_tile_writer() failed\n");
+        return false;
     }
 
-    return descriptor_pool;
+    return true;
 }
 
-static VkDescriptorSet create_descriptor_set(VkDevice device, VkDescriptorPool descriptor_pool,
-                                             VkDescriptorSetLayout layout) {
-    const VkDescriptorSetAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = descriptor_pool,
-        .descriptorSetCount = 1,
-        .pSetLayouts = &layout,
-    };
-
-    VkDescriptorSet descriptor_set;
-    VkResult result = vkAllocateDescriptorSets(device, &alloc_info, &descriptor_set);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkAllocateDescriptorSets failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+/* File extension of the encoder write_frame() uses for `format`. */
+static const char *frame_extension(Readback_Format format) {
+    switch (format) {
+    case READBACK_FORMAT_RGBA8:
+    case READBACK_FORMAT_RGB8:
+        return "png";
+    case READBACK_FORMAT_RGBA32F:
+        return "hdr";
+    default:
+        return "raw";
     }
-
-    return descriptor_set;
 }
 
-static VmaAllocator create_vma_allocator(VkInstance instance, VkDevice device,
-                                         const Physical_Device_Info *info) {
-    const VmaAllocatorCreateInfo vma_allocator_info = {
-        .vulkanApiVersion = VK_API_VERSION_1_0,
-        .physicalDevice = info->physical_device,
-        .device = device,
-        .instance = instance,
-    };
+/* Writes the rows of a frame without a header, as the readback layout has them. */
+static bool write_raw(const char *path, const void *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
 
-    VmaAllocator allocator;
-    VkResult result = vmaCreateAllocator(&vma_allocator_info, &allocator);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vmaCreateAllocator() failed: %s\n", string_VkResult(result));
-        return NULL;
+    bool written = fwrite(data, 1, size, file) == size;
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
     }
 
-    return allocator;
+    return true;
 }
 
-static VkImage create_compute_image(VmaAllocator allocator, uint32_t width, uint32_t height,
-                                    VkFormat format, VmaAllocation *allocation) {
-    const VkImageCreateInfo image_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .imageType = VK_IMAGE_TYPE_2D,
-        .format = format,
-        .extent =
-            (VkExtent3D){
-                .width = width,
-                .height = height,
-                .depth = 1,
-            },
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-    };
+/* Encodes an untiled frame in its readback format: 8-bit formats as PNG, rgba32f as Radiance HDR
+ * and the other float formats as raw rows.
+ */
+static bool encode_frame(const Readback_Layout *layout, const char *path, const void *data) {
+    switch (layout->format) {
+    case READBACK_FORMAT_RGBA8:
+    case READBACK_FORMAT_RGB8:
+        if (!stbi_write_png(path, (int)layout->width, (int)layout->height,
+                            (int)layout->pixel_size, data, (int)layout->row_pitch)) {
+            fprintf(stderr, "stbi_write_png() failed: %s\n", path);
+            return false;
+        }
 
-    const VmaAllocationCreateInfo alloc_info = {
-        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-    };
+        return true;
+    case READBACK_FORMAT_RGBA32F:
+        /* Rows of 16-byte pixels need no padding, so they are as tight as stbi expects. */
+        if (!stbi_write_hdr(path, (int)layout->width, (int)layout->height, 4, data)) {
+            fprintf(stderr, "stbi_write_hdr() failed: %s\n", path);
+            return false;
+        }
 
-    VkImage image;
-    VkResult result = vmaCreateImage(allocator, &image_info, &alloc_info, &image, allocation, NULL);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vmaCreateImage() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+        return true;
+    default:
+        return write_raw(path, data, (size_t)layout->size);
     }
-
-    return image;
 }
 
-static VkImageView create_compute_image_view(VkDevice device, VkImage image, VkFormat format) {
-    const VkImageViewCreateInfo image_view_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-        .image = image,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = format,
-        .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-        .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
-        .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
-        .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
-        .subresourceRange =
-            (VkImageSubresourceRange){
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-    };
-
-    VkImageView view;
-    VkResult result = vkCreateImageView(device, &image_view_info, NULL, &view);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateImageView() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+/* Waits for renderer frame `frame_index`, writes it to output.<ext>, or to output_NNNN.<ext> when
+ * rendering a sequence, and releases its readback buffer. Tiled frames go to .ppm files instead.
+ */
+static bool write_frame(Renderer *renderer, uint32_t frame_index, Frame_Writer *writer) {
+    uint64_t wait_start_ns = timer_now_ns();
+    if (!wait_for_frame(renderer, frame_index)) {
+        fprintf(stderr, "wait_for_frame() failed\n");
+        return false;
     }
 
-    return view;
-}
+    uint64_t write_start_ns = timer_now_ns();
+    writer->wait_ns += write_start_ns - wait_start_ns;
 
-static VkCommandPool create_command_pool(VkDevice device, const Physical_Device_Info *info) {
-    const VkCommandPoolCreateInfo command_pool_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = info->compute_family_index,
-    };
+    if (writer->tile_count > 1) {
+        if (!write_tile_frame(renderer, frame_index, writer)) {
+            return false;
+        }
+    } else {
+        const Readback_Layout *layout = &renderer->info.readback;
+        const char *extension = frame_extension(layout->format);
+
+        char path[32];
+        if (writer->frame_count == 1) {
+            snprintf(path, sizeof(path), "output.%s", extension);
+        } else {
+            snprintf(path, sizeof(path), "output_%04u.%s", frame_index, extension);
+        }
 
-    VkCommandPool command_pool;
-    VkResult result = vkCreateCommandPool(device, &command_pool_info, NULL, &command_pool);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkCreateCommandPool() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+        if (!encode_frame(layout, path, get_frame_pixels(renderer, frame_index))) {
+            fprintf(stderr, "encode_frame() failed\n");
+            return false;
+        }
     }
 
-    return command_pool;
-}
+    uint64_t end_ns = timer_now_ns();
+    writer->write_ns += end_ns - write_start_ns;
 
-static VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool command_pool) {
-    const VkCommandBufferAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = command_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
+    if (!release_frame(renderer, frame_index)) {
+        fprintf(stderr, "release_frame() failed\n");
+        return false;
+    }
 
-    VkCommandBuffer command_buffer;
-    VkResult result = vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vkAllocateCommandBuffers() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+    if ((frame_index + 1) % writer->tile_count == 0) {
+        uint64_t frame_ns = end_ns - writer->last_frame_end_ns;
+        writer->last_frame_end_ns = end_ns;
+
+        if (frame_ns < writer->frame_min_ns || frame_index + 1 == writer->tile_count) {
+            writer->frame_min_ns = frame_ns;
+        }
+
+        if (frame_ns > writer->frame_max_ns) {
+            writer->frame_max_ns = frame_ns;
+        }
+
+        if (writer->verbose) {
+            fprintf(stderr, "Frame %u: %.3f ms\n", frame_index / writer->tile_count,
+                    timer_ms_between(0, frame_ns));
+        }
     }
 
-    return command_buffer;
+    return true;
 }
 
-static VkBuffer create_host_buffer(VmaAllocator allocator, VkDeviceSize size,
-                                   VmaAllocation *allocation, VmaAllocationInfo *allocation_info) {
-    const VkBufferCreateInfo buffer_info = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = size,
-        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-    };
+/* Waits for the preview queued last and overwrites preview.png with it. */
+static bool write_preview(Renderer *renderer, Frame_Writer *writer) {
+    uint64_t start_ns = timer_now_ns();
 
-    const VmaAllocationCreateInfo alloc_info = {
-        .usage = VMA_MEMORY_USAGE_AUTO,
-        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
-    };
+    const void *data = wait_for_preview(renderer);
+    if (!data) {
+        fprintf(stderr, "wait_for_preview() failed\n");
+        return false;
+    }
 
-    VkBuffer buffer;
-    VkResult result =
-        vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer, allocation, allocation_info);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "vmaCreateBuffer() failed: %s\n", string_VkResult(result));
-        return VK_NULL_HANDLE;
+    const Readback_Layout *layout = &renderer->info.preview;
+    if (!stbi_write_png("preview.png", (int)layout->width, (int)layout->height,
+                        (int)layout->pixel_size, data, (int)layout->row_pitch)) {
+        fprintf(stderr, "stbi_write_png() failed: preview.png\n");
+        return false;
     }
 
-    return buffer;
+    writer->preview_ns += timer_now_ns() - start_ns;
+    return true;
 }
 
-int main(void) {
-    const VkDebugUtilsMessengerCreateInfoEXT debug_info = {
-        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        return options.help ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    Profile profile;
+    profile_init(&profile);
+
+    /* Every frame of a sequence shares the process's device, pipeline and buffers; only the
+     * camera written with each slice changes.
+     */
+    Sequence sequence = {0};
+    uint32_t frame_count = options.frames;
+    if (options.sequence_path) {
+        profile_begin(&profile, "sequence");
+        if (!load_sequence(options.sequence_path, &sequence)) {
+            fprintf(stderr, "load_sequence() failed\n");
+            return EXIT_FAILURE;
+        }
+        profile_end(&profile);
 
-        .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-                           VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-                           VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-                           VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+        frame_count = sequence.frame_count;
+    }
 
-        .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-                       VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-                       VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+    /* Outlives every Vulkan object, so it is set up first and torn down last. */
+    Host_Allocator tracked_host_allocator;
+    Host_Allocator *host_allocator = NULL;
+    if (options.track_host_allocations) {
+        init_host_allocator(&tracked_host_allocator);
+        host_allocator = &tracked_host_allocator;
+    }
 
-        .pfnUserCallback = &vulkan_debug_callback,
+    const Instance_Info instance_info = {
+        .validation = options.validation,
+        .verbose = options.verbose,
+        .host_allocator = host_allocator,
     };
 
-    VkInstance instance = create_instance(&debug_info);
-    if (!instance) {
+    profile_begin(&profile, "instance");
+    Instance instance;
+    if (!create_instance(&instance_info, &instance)) {
         fprintf(stderr, "create_instance() failed\n");
         return EXIT_FAILURE;
     }
 
-    VkDebugUtilsMessengerEXT messenger = create_debug_messenger(instance, &debug_info);
-    if (!messenger) {
-        fprintf(stderr, "create_debug_messenger() failed\n");
-        return EXIT_FAILURE;
-    }
+    profile_end(&profile);
+
+    profile_begin(&profile, "device");
+    const Device_Info device_info = {
+        .selector = options.device_selector,
+        .disable_transfer_queue = options.disable_transfer_queue,
+        .verbose = options.verbose,
+        .host_allocator = host_allocator,
+    };
 
     Device device;
-    if (!create_device(instance, &device)) {
+    if (!create_device(&instance, &device_info, &device)) {
         fprintf(stderr, "create_device() failed\n");
         return EXIT_FAILURE;
     }
+    profile_end(&profile);
 
-    VkShaderModule shader = load_shader_module(device.device, "shaders/pathtracer.comp.spv");
-    if (!shader) {
-        fprintf(stderr, "load_shader_module() failed\n");
-        return EXIT_FAILURE;
+    /* An output larger than one image allows is rendered in tiles, whose accumulation target and
+     * buffers are all that is allocated.
+     */
+    uint32_t max_image_dimension = device.info.properties.limits.maxImageDimension2D;
+    uint32_t tile_size = options.tile_size;
+    bool exceeds_limit =
+        options.width > max_image_dimension || options.height > max_image_dimension;
+    if (!tile_size && exceeds_limit) {
+        tile_size =
+            DEFAULT_TILE_SIZE < max_image_dimension ? DEFAULT_TILE_SIZE : max_image_dimension;
     }
 
-    const Pathtracing_Pipeline_Info pipeline_info = {
-        .compute_shader = shader,
-        .workgroup_sizes =
-            {
-                .x = 8,
-                .y = 4,
-                .z = 1,
-            },
-    };
-
-    Pathtracing_Pipeline pipeline;
-    if (!create_pathtracing_pipeline(&device, &pipeline_info, &pipeline)) {
-        fprintf(stderr, "create_pathtracing_pipeline() failed\n");
+    if (tile_size > max_image_dimension) {
+        fprintf(stderr, "Tile size %u exceeds the device limit of %u\n", tile_size,
+                max_image_dimension);
         return EXIT_FAILURE;
     }
 
-    const uint32_t image_width = 512;
-    const uint32_t image_height = 512;
-    VkFormat image_format = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t image_width = options.width;
+    uint32_t image_height = options.height;
+    if (tile_size) {
+        image_width = tile_size < options.width ? tile_size : options.width;
+        image_height = tile_size < options.height ? tile_size : options.height;
+    }
+
+    uint32_t tiles_x = (options.width + image_width - 1) / image_width;
+    uint32_t tiles_y = (options.height + image_height - 1) / image_height;
+    uint32_t tile_count = tiles_x * tiles_y;
+    uint32_t render_count = frame_count * tile_count;
 
-    VkDescriptorPool descriptor_pool = create_descriptor_pool(device.device);
-    if (!descriptor_pool) {
-        fprintf(stderr, "create_descriptor_pool() failed\n");
+    /* Frames are packed on the GPU into exactly what the encoder writes, so the copy and the
+     * readback buffers are no larger than the file's pixels. Tiles are streamed into a PPM.
+     */
+    Readback_Format readback_format = READBACK_FORMAT_RGB8;
+    if (options.output_format &&
+        !find_readback_format(options.output_format, &readback_format)) {
+        fprintf(stderr, "Unknown output format: %s\n", options.output_format);
         return EXIT_FAILURE;
     }
 
-    VkDescriptorSet descriptor_set =
-        create_descriptor_set(device.device, descriptor_pool, pipeline.descriptor_set_layout);
-    if (!descriptor_set) {
-        fprintf(stderr, "create_descriptor_set() failed\n");
+    if (tile_count > 1 && readback_format != READBACK_FORMAT_RGB8) {
+        fprintf(stderr, "Tiled output is written as PPM, which needs --output-format rgb8\n");
         return EXIT_FAILURE;
     }
 
-    VmaAllocator allocator = create_vma_allocator(instance, device.device, &device.info);
-    if (!allocator) {
-        fprintf(stderr, "create_vma_allocator() failed\n");
-        return EXIT_FAILURE;
+    const Readback_Layout readback_layout =
+        get_readback_layout(readback_format, image_width, image_height, 4);
+
+    /* Previews show the image being rendered, which is one tile of a tiled output. */
+    uint32_t preview_scale = options.preview_passes ? options.preview_scale : 0;
+    Readback_Layout preview_layout = {0};
+    if (preview_scale) {
+        preview_layout = get_readback_layout(READBACK_FORMAT_RGB8,
+                                             (image_width + preview_scale - 1) / preview_scale,
+                                             (image_height + preview_scale - 1) / preview_scale, 4);
     }
 
-    VmaAllocation compute_image_allocation;
-    VkImage compute_image = create_compute_image(allocator, image_width, image_height, image_format,
-                                                 &compute_image_allocation);
-    if (!compute_image) {
-        fprintf(stderr, "create_compute_image() failed\n");
+    uint32_t scene_features = PIPELINE_SCENE_GROUND;
+    if (options.scene_features && !parse_scene_features(options.scene_features, &scene_features)) {
         return EXIT_FAILURE;
     }
 
-    VkImageView compute_image_view =
-        create_compute_image_view(device.device, compute_image, image_format);
-    if (!compute_image_view) {
-        fprintf(stderr, "create_compute_image_view() failed\n");
-        return EXIT_FAILURE;
+    Pathtracing_Constants pathtracing_constants = {
+        .max_bounces = options.max_bounces,
+        .samples_per_dispatch = options.samples_per_dispatch,
+        .scene_features = scene_features,
+        .push_params = options.rerecord_passes,
+    };
+
+    /* The workgroup size found for this device by an earlier --autotune, if any. */
+    Workgroup_Tuning tuning;
+    bool tuned = false;
+    if (options.autotune) {
+        profile_begin(&profile, "autotune");
+        tuned = tune_workgroup_sizes(&instance, &device, &options, &pathtracing_constants, &tuning);
+        profile_end(&profile);
+
+        if (!tuned) {
+            fprintf(stderr, "tune_workgroup_sizes() failed\n");
+            return EXIT_FAILURE;
+        }
+
+        if (options.tuning_path &&
+            !save_workgroup_tuning(&device, options.tuning_path, &tuning)) {
+            fprintf(stderr, "Warning: save_workgroup_tuning() failed\n");
+        }
+    } else if (options.tuning_path) {
+        tuned = load_workgroup_tuning(&device, options.tuning_path, &tuning);
+    }
+
+    const Workgroup_Sizes workgroup_sizes =
+        tuned ? tuning.workgroup_sizes : DEFAULT_WORKGROUP_SIZES;
+    pathtracing_constants.workgroup_sizes = workgroup_sizes;
+
+    if (options.verbose) {
+        fprintf(stderr, "Workgroup size %ux%ux%u (%s)\n", workgroup_sizes.x, workgroup_sizes.y,
+                workgroup_sizes.z,
+                options.autotune ? "autotuned" : tuned ? options.tuning_path : "default");
     }
 
-    VmaAllocation host_buf_allocation;
-    VmaAllocationInfo host_buf_alloc_info;
-    VkBuffer host_buf =
-        create_host_buffer(allocator, 4 * sizeof(uint32_t) * image_width * image_height,
-                           &host_buf_allocation, &host_buf_alloc_info);
-    if (!host_buf) {
-        fprintf(stderr, "create_host_buffer() failed\n");
+    bool zero_copy = !options.disable_zero_copy && renderer_supports_zero_copy(&device);
+
+    /* Everything below only needs the VkDevice, so the pipeline compiles on a worker thread while
+     * this thread sets up memory. The two meet at bind_renderer_pipeline().
+     */
+    Pipeline_Build pipeline_build = {
+        .device = &device,
+        .options = &options,
+        .constants = pathtracing_constants,
+        .readback = readback_layout,
+        .preview_scale = preview_scale,
+        .preview = preview_layout,
+    };
+
+    Task pipeline_task;
+    task_start(&pipeline_task, "pipeline", build_pipeline, &pipeline_build, !options.serial_init);
+    bool parallel_init = pipeline_task.threaded;
+
+    profile_begin(&profile, "allocator");
+    VmaAllocator allocator = create_vma_allocator(instance.instance, &device);
+    if (!allocator) {
+        fprintf(stderr, "create_vma_allocator() failed\n");
         return EXIT_FAILURE;
     }
+    profile_end(&profile);
+
+    const Renderer_Info renderer_info = {
+        .workgroup_sizes = workgroup_sizes,
+        .width = image_width,
+        .height = image_height,
+        .readback = readback_layout,
+        .output_width = options.width,
+        .output_height = options.height,
+        .passes = options.passes,
+        .rerecord_passes = options.rerecord_passes,
+        .seed = options.seed,
+        .slice_ms = options.slice_ms,
+        .zero_copy = zero_copy,
+        .preview_scale = preview_scale,
+        .preview = preview_layout,
+    };
 
-    VkCommandPool command_pool = create_command_pool(device.device, &device.info);
-    if (!command_pool) {
-        fprintf(stderr, "create_command_pool() failed\n");
+    Renderer renderer;
+    if (!create_renderer(&device, allocator, &renderer_info, &profile, &renderer)) {
+        fprintf(stderr, "create_renderer() failed\n");
         return EXIT_FAILURE;
     }
 
-    VkCommandBuffer command_buffer = create_command_buffer(device.device, command_pool);
-    if (!command_buffer) {
-        fprintf(stderr, "create_command_buffer() failed\n");
+    profile_begin(&profile, "pipeline_wait");
+    bool pipeline_built = task_wait(&pipeline_task);
+    profile_end(&profile);
+
+    profile_merge(&profile, &pipeline_build.profile);
+    double pipeline_task_ms = timer_ms_between(pipeline_task.start_ns, pipeline_task.end_ns);
+    if (!pipeline_built) {
+        fprintf(stderr, "build_pipeline() failed\n");
         return EXIT_FAILURE;
     }
 
-    const VkWriteDescriptorSet write_descriptor_set = {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = descriptor_set,
-        .dstBinding = 0,
-        .dstArrayElement = 0,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-        .pImageInfo =
-            &(VkDescriptorImageInfo){
-                .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-                .imageView = compute_image_view,
-            },
-    };
+    const Pipeline_Cache *pipeline_cache = &pipeline_build.pipeline_cache;
+    const Pathtracing_Pipeline *pipeline = &pipeline_build.pipeline;
+
+    if (options.verbose) {
+        fprintf(stderr, "Pipeline cache %s (%s, %zu bytes, loaded in %.3f ms)\n",
+                pipeline_cache->stats.hit ? "hit" : "miss",
+                pipeline_cache->stats.hit ? options.pipeline_cache_path
+                                          : pipeline_cache->stats.miss_reason,
+                pipeline_cache->stats.loaded_bytes, pipeline_cache->stats.load_ms);
+        fprintf(stderr,
+                "Pipeline created in %.3f ms (%u bounces, %u samples per dispatch, scene 0x%x)\n",
+                pipeline->creation_ms, pipeline->constants.max_bounces,
+                pipeline->constants.samples_per_dispatch, pipeline->constants.scene_features);
+
+        for (uint32_t i = 0; i < pipeline->variant_count; i++) {
+            const Pathtracing_Variant *variant = &pipeline->variants[i];
+            fprintf(stderr, "  kernel %s: variant %016llx in %.3f ms\n",
+                    kernel_name(variant->kernel), (unsigned long long)variant->hash,
+                    variant->creation_ms);
+        }
 
-    vkUpdateDescriptorSets(device.device, 1, &write_descriptor_set, 0, NULL);
+        const Bindless_Layout *scene_layout = &pipeline->scene_layout;
+        fprintf(stderr, "Scene descriptors: %s (%u buffers, %u images, %u samplers)\n",
+                scene_layout->bindless ? "bindless" : "fixed", scene_layout->buffer_capacity,
+                scene_layout->image_capacity, scene_layout->sampler_capacity);
+    }
 
-    VkResult record_result = vkBeginCommandBuffer(
-        command_buffer, &(VkCommandBufferBeginInfo){
-                            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                        });
-    if (record_result != VK_SUCCESS) {
-        fprintf(stderr, "vkBeginCommandBuffer() failed: %s\n", string_VkResult(record_result));
+    if (!bind_renderer_pipeline(&renderer, pipeline, &pipeline_build.pack_pipeline,
+                                preview_scale ? &pipeline_build.preview_pipeline : NULL)) {
+        fprintf(stderr, "bind_renderer_pipeline() failed\n");
         return EXIT_FAILURE;
     }
 
-    /* Transition from undefined to general for compute shader write operations. */
-    const VkImageMemoryBarrier trans_to_general = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = compute_image,
-        .subresourceRange =
-            (VkImageSubresourceRange){
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
+    if (options.verbose) {
+        fprintf(stderr, "Output path: %s, %s (%llu bytes per frame)\n",
+                zero_copy ? "zero-copy (host-visible device memory)" : "readback copy",
+                readback_format_name(readback_format),
+                (unsigned long long)readback_layout.size);
+    }
+
+    if (options.verbose && tile_count > 1) {
+        fprintf(stderr, "Rendering %ux%u in %u tiles of %ux%u\n", options.width, options.height,
+                tile_count, image_width, image_height);
+    }
+
+    /* Frame k, a whole output frame or one tile of it, is waited on and written while frame
+     * k + 1 renders.
+     */
+    profile_begin(&profile, "frames");
+    uint64_t frames_start_ns = timer_now_ns();
+    double time_to_first_dispatch_ms = 0.0;
+    Frame_Writer writer = {
+        .frame_count = frame_count,
+        .tiles_x = tiles_x,
+        .tile_count = tile_count,
+        .output_width = options.width,
+        .output_height = options.height,
+        .last_frame_end_ns = frames_start_ns,
+        .verbose = options.verbose,
     };
 
-    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1,
-                         &trans_to_general);
-
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 1,
-                            &descriptor_set, 0, NULL);
-
-    vkCmdDispatch(
-        command_buffer,
-        (image_width + pipeline_info.workgroup_sizes.x - 1) / pipeline_info.workgroup_sizes.x,
-        (image_height + pipeline_info.workgroup_sizes.y - 1) / pipeline_info.workgroup_sizes.y,
-        pipeline_info.workgroup_sizes.z);
-
-    /* Transition from general to transfer src optimal for device -> host copy */
-    const VkImageMemoryBarrier trans_to_trans_src = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = compute_image,
-        .subresourceRange =
-            (VkImageSubresourceRange){
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-    };
+    const Camera fixed_camera = default_camera();
+    for (uint32_t frame = 0; frame < render_count; frame++) {
+        uint32_t tile_x;
+        uint32_t tile_y;
+        tile_origin(&renderer, &writer, frame % tile_count, &tile_x, &tile_y);
 
-    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
-                         &trans_to_trans_src);
-
-    const VkBufferImageCopy copy_region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource =
-            {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = 0,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-        .imageOffset = {0, 0, 0},
-        .imageExtent = {image_width, image_height, 1},
-    };
+        const Camera *camera = &fixed_camera;
+        if (sequence.cameras) {
+            camera = &sequence.cameras[frame / tile_count];
+        }
 
-    vkCmdCopyImageToBuffer(command_buffer, compute_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                           host_buf, 1, &copy_region);
+        if (!begin_frame(&renderer, tile_x, tile_y, camera)) {
+            fprintf(stderr, "begin_frame() failed\n");
+            return EXIT_FAILURE;
+        }
 
-    record_result = vkEndCommandBuffer(command_buffer);
-    if (record_result != VK_SUCCESS) {
-        fprintf(stderr, "vkEndCommandBuffer() failed: %s\n", string_VkResult(record_result));
-        return EXIT_FAILURE;
+        for (uint32_t pass = 0; pass < options.passes; pass++) {
+            if (!submit_pass(&renderer)) {
+                fprintf(stderr, "submit_pass() failed\n");
+                return EXIT_FAILURE;
+            }
+
+            if (frame == 0 && pass == 0) {
+                time_to_first_dispatch_ms = timer_ms_between(profile.origin_ns, timer_now_ns());
+            }
+
+            /* The full frame is read back after the last pass anyway. The previous preview was
+             * queued `preview_passes` passes ago, so waiting for it rarely blocks.
+             */
+            bool preview_due = options.preview_passes && pass + 1 < options.passes &&
+                               (pass + 1) % options.preview_passes == 0;
+            if (preview_due) {
+                if (renderer.preview_pending && !write_preview(&renderer, &writer)) {
+                    return EXIT_FAILURE;
+                }
+
+                if (!submit_preview(&renderer)) {
+                    fprintf(stderr, "submit_preview() failed\n");
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+
+        if (frame > 0 && !write_frame(&renderer, frame - 1, &writer)) {
+            return EXIT_FAILURE;
+        }
     }
 
-    const VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pCommandBuffers = &command_buffer,
-        .commandBufferCount = 1,
-    };
+    if (!write_frame(&renderer, render_count - 1, &writer)) {
+        return EXIT_FAILURE;
+    }
 
-    vkQueueSubmit(device.compute_queue, 1, &submit_info, NULL);
-    vkQueueWaitIdle(device.compute_queue);
+    if (renderer.preview_pending && !write_preview(&renderer, &writer)) {
+        return EXIT_FAILURE;
+    }
 
-    uint8_t *data = host_buf_alloc_info.pMappedData;
+    double frames_ms = timer_ms_between(frames_start_ns, timer_now_ns());
+    profile_end(&profile);
+
+    double fps = frame_count / (frames_ms / 1000.0);
+
+    /* Per-frame cost once everything is set up, and with the setup spread over the frames. */
+    double setup_ms = timer_ms_between(profile.origin_ns, frames_start_ns);
+    double frame_ms_min = timer_ms_between(0, writer.frame_min_ns);
+    double frame_ms_mean = frames_ms / frame_count;
+    double frame_ms_max = timer_ms_between(0, writer.frame_max_ns);
+    double amortised_frame_ms = (setup_ms + frames_ms) / frame_count;
+    double queue_wait_ms = timer_ms_between(0, writer.wait_ns);
+    double write_png_ms = timer_ms_between(0, writer.write_ns);
+    double preview_ms = timer_ms_between(0, writer.preview_ns);
+    uint32_t preview_count = renderer.preview_count;
+
+    /* Host cost of one pass, replayed or re-recorded depending on --rerecord-passes. */
+    double submit_cpu_us_per_pass =
+        (double)renderer.submit_cpu_ns / 1000.0 / ((double)render_count * options.passes);
+
+    /* Averaged over every frame, including those before the slice height settled. */
+    double slices_per_pass =
+        (double)renderer.total_slices / ((double)render_count * options.passes);
+    double slice_gpu_ms =
+        renderer.timed_slices ? renderer.slice_gpu_ms / renderer.timed_slices : 0.0;
+
+    if (options.verbose) {
+        fprintf(stderr,
+                "Time to first dispatch: %.3f ms (%s initialisation, pipeline task %.3f ms)\n",
+                time_to_first_dispatch_ms, parallel_init ? "parallel" : "serial",
+                pipeline_task_ms);
+        fprintf(stderr, "Host time per pass: %.3f us (%s)\n", submit_cpu_us_per_pass,
+                options.rerecord_passes ? "re-recorded" : "replayed");
+        if (renderer.timestamp_pool) {
+            fprintf(stderr, "%.2f slices per pass, %.3f ms GPU per slice (target %.3f ms)\n",
+                    slices_per_pass, slice_gpu_ms, options.slice_ms);
+        } else if (options.slice_ms > 0.0) {
+            fprintf(stderr, "Passes not sliced: the compute queue has no timestamps\n");
+        }
+        fprintf(stderr, "%u frames in %.3f ms (%.2f fps, %.3f ms waiting, %.3f ms writing)\n",
+                frame_count, frames_ms, fps, queue_wait_ms, write_png_ms);
+        fprintf(stderr,
+                "Per frame: %.3f ms min, %.3f ms mean, %.3f ms max; %.3f ms amortised over "
+                "%.3f ms setup\n",
+                frame_ms_min, frame_ms_mean, frame_ms_max, amortised_frame_ms, setup_ms);
+        if (preview_scale) {
+            fprintf(stderr, "%u previews of %ux%u in %.3f ms\n", preview_count,
+                    preview_layout.width, preview_layout.height, preview_ms);
+        }
+    }
 
-    stbi_write_png("output.png", image_width, image_height, 4, data, 4 * image_width);
+    profile_begin(&profile, "teardown");
 
-    vkDestroyCommandPool(device.device, command_pool, NULL);
-    vkDestroyImageView(device.device, compute_image_view, NULL);
-    vmaDestroyBuffer(allocator, host_buf, host_buf_allocation);
-    vmaDestroyImage(allocator, compute_image, compute_image_allocation);
+    destroy_renderer(&renderer);
     vmaDestroyAllocator(allocator);
-    vkDestroyDescriptorPool(device.device, descriptor_pool, NULL);
-    destroy_pathtracing_pipeline(&device, &pipeline);
-    vkDestroyShaderModule(device.device, shader, NULL);
+    destroy_pack_pipeline(&device, &pipeline_build.preview_pipeline);
+    destroy_pack_pipeline(&device, &pipeline_build.pack_pipeline);
+    destroy_pathtracing_pipeline(&device, &pipeline_build.pipeline);
+
+    profile_begin(&profile, "pipeline_cache_save");
+    bool cache_saved = save_pipeline_cache(&device, &pipeline_build.pipeline_cache);
+    profile_end(&profile);
+
+    if (!cache_saved) {
+        fprintf(stderr, "Warning: save_pipeline_cache() failed\n");
+    } else if (options.verbose && pipeline_cache->stats.saved_bytes) {
+        fprintf(stderr, "Pipeline cache saved (%zu bytes in %.3f ms)\n",
+                pipeline_cache->stats.saved_bytes, pipeline_cache->stats.save_ms);
+    }
+
+    destroy_pipeline_cache(&device, &pipeline_build.pipeline_cache);
+    vkDestroyShaderModule(device.device, pipeline_build.pack_shader,
+                          host_allocator_callbacks(host_allocator, HOST_ALLOCATION_SHADER));
     destroy_device(&device);
-    DestroyDebugUtilsMessengerEXT(instance, messenger, NULL);
-    vkDestroyInstance(instance, NULL);
+    destroy_instance(&instance);
+    profile_end(&profile);
+
+    Host_Allocator_Stats host_stats = {0};
+    if (host_allocator) {
+        host_stats = get_host_allocator_stats(host_allocator);
+        if (options.verbose) {
+            print_host_allocator_stats(&host_stats);
+        }
+    }
+
+    if (options.timing_report_path) {
+        profile_set_string(&profile, "device", device.info.properties.deviceName);
+        profile_set_string(&profile, "output_path", zero_copy ? "zero_copy" : "readback");
+        profile_set_number(&profile, "width", options.width);
+        profile_set_number(&profile, "height", options.height);
+        profile_set_string(&profile, "readback_format", readback_format_name(readback_format));
+        profile_set_number(&profile, "readback_bytes", (double)readback_layout.size);
+        profile_set_number(&profile, "tile_size", tile_size);
+        profile_set_number(&profile, "tiles", tile_count);
+        profile_set_number(&profile, "validation", instance.validation_enabled);
+        profile_set_number(&profile, "frames", frame_count);
+        profile_set_number(&profile, "sequence", sequence.cameras != NULL);
+        profile_set_number(&profile, "setup_ms", setup_ms);
+        profile_set_number(&profile, "frame_ms_min", frame_ms_min);
+        profile_set_number(&profile, "frame_ms_mean", frame_ms_mean);
+        profile_set_number(&profile, "frame_ms_max", frame_ms_max);
+        profile_set_number(&profile, "amortised_frame_ms", amortised_frame_ms);
+        profile_set_number(&profile, "fps", fps);
+        profile_set_number(&profile, "queue_wait_ms", queue_wait_ms);
+        profile_set_number(&profile, "write_png_ms", write_png_ms);
+        profile_set_number(&profile, "previews", preview_count);
+        profile_set_number(&profile, "preview_bytes", (double)preview_layout.size);
+        profile_set_number(&profile, "preview_ms", preview_ms);
+        profile_set_number(&profile, "passes", options.passes);
+        profile_set_number(&profile, "workgroup_x", workgroup_sizes.x);
+        profile_set_number(&profile, "workgroup_y", workgroup_sizes.y);
+        profile_set_number(&profile, "workgroup_tuned", tuned);
+        if (tuned) {
+            profile_set_number(&profile, "workgroup_gpu_ms_per_megapixel",
+                               tuning.gpu_ms_per_megapixel);
+        }
+        profile_set_number(&profile, "max_bounces", pathtracing_constants.max_bounces);
+        profile_set_number(&profile, "samples_per_dispatch",
+                           pathtracing_constants.samples_per_dispatch);
+        profile_set_number(&profile, "scene_features", pathtracing_constants.scene_features);
+        profile_set_number(&profile, "bindless", pipeline->scene_layout.bindless);
+        profile_set_number(&profile, "rerecord_passes", options.rerecord_passes);
+        profile_set_number(&profile, "seed", options.seed);
+        profile_set_number(&profile, "submit_cpu_us_per_pass", submit_cpu_us_per_pass);
+        profile_set_number(&profile, "slice_ms", options.slice_ms);
+        profile_set_number(&profile, "slices_per_pass", slices_per_pass);
+        profile_set_number(&profile, "slice_gpu_ms", slice_gpu_ms);
+        profile_set_number(&profile, "parallel_init", parallel_init);
+        profile_set_number(&profile, "pipeline_task_ms", pipeline_task_ms);
+        profile_set_number(&profile, "time_to_first_dispatch_ms", time_to_first_dispatch_ms);
+        profile_set_number(&profile, "pipeline_cache_hit", pipeline_cache->stats.hit);
+        profile_set_number(&profile, "pipeline_cache_loaded_bytes",
+                           (double)pipeline_cache->stats.loaded_bytes);
+        profile_set_number(&profile, "pipeline_cache_saved_bytes",
+                           (double)pipeline_cache->stats.saved_bytes);
+
+        if (host_allocator) {
+            profile_set_number(&profile, "host_peak_bytes", (double)host_stats.total.peak_bytes);
+            profile_set_number(&profile, "host_allocation_count",
+                               (double)host_stats.total.allocation_count);
+            profile_set_number(&profile, "host_internal_peak_bytes",
+                               (double)host_stats.internal_peak_bytes);
+        }
+
+        if (!profile_write_json(&profile, options.timing_report_path)) {
+            fprintf(stderr, "Warning: profile_write_json() failed\n");
+        }
+    }
+
+    if (host_allocator) {
+        destroy_host_allocator(host_allocator);
+    }
+
+    destroy_sequence(&sequence);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,355 @@
+#include "options.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CALYKO_VALIDATION_DEFAULT
+#define CALYKO_VALIDATION_DEFAULT 1
+#endif
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "\n"
+            "Options:\n"
+            "  --validation      Enable the validation layer and debug messenger\n"
+            "  --no-validation   Create a bare instance without layers or debug utils\n"
+            "  --verbose         Print startup diagnostics and verbose validation output\n"
+            "  --device <index|uuid|name>\n"
+            "                    Use a specific physical device instead of the best ranked\n"
+            "  --no-transfer-queue\n"
+            "                    Copy results on the compute queue instead of a transfer queue\n"
+            "  --no-zero-copy    Copy results back even if the GPU can write host memory\n"
+            "  --serial-init     Compile pipelines before, not during, resource setup\n"
+            "  --size <w>x<h>    Render a <w> by <h> pixel output (default: 512x512)\n"
+            "  --tile <n>        Render in <n> by <n> tiles and write PPM, for outputs larger\n"
+            "                    than GPU limits (default: only when required)\n"
+            "  --output-format <rgb8|rgba8|rgba16f|rgba32f|r11g11b10f>\n"
+            "                    Read frames back in this format and write them as PNG (8-bit),\n"
+            "                    Radiance HDR (rgba32f) or raw rows (default: rgb8)\n"
+            "  --frames <n>      Render a sequence of <n> frames (default: 1)\n"
+            "  --sequence <path> Render one frame per camera line of <path>: position xyz,\n"
+            "                    target xyz and vertical field of view in degrees\n"
+            "  --passes <n>      Accumulate <n> sample passes per frame (default: 1)\n"
+            "  --preview <n>     Write a downsampled preview.png every <n> passes\n"
+            "  --preview-scale <n>\n"
+            "                    Downsample previews by <n> on each axis (default: 8)\n"
+            "  --bounces <n>     Follow paths for up to <n> bounces (default: 4)\n"
+            "  --samples-per-dispatch <n>\n"
+            "                    Take <n> samples per pixel in each dispatch (default: 1)\n"
+            "  --scene <features>\n"
+            "                    Comma-separated scene features compiled into the kernel:\n"
+            "                    ground, sun, or none (default: ground)\n"
+            "  --seed <n>        Seed the random sequence with <n> (default: 0)\n"
+            "  --rerecord-passes Record every pass again instead of replaying it, with its\n"
+            "                    parameters in push constants\n"
+            "  --slice-ms <ms>   Split passes into dispatches of about <ms> of GPU time,\n"
+            "                    0 for whole passes (default: 10)\n"
+            "  --track-host-allocations\n"
+            "                    Count Vulkan host allocations per object type\n"
+            "  --pipeline-cache <path>\n"
+            "                    Load and store the pipeline cache at <path>\n"
+            "                    (default: " DEFAULT_PIPELINE_CACHE_PATH ")\n"
+            "  --no-pipeline-cache\n"
+            "                    Compile pipelines without a persistent cache\n"
+            "  --autotune        Time workgroup sizes on this device, store the fastest in the\n"
+            "                    tuning file and render with it\n"
+            "  --tuning-file <path>\n"
+            "                    Load and store per-device workgroup sizes at <path>\n"
+            "                    (default: " DEFAULT_TUNING_PATH ")\n"
+            "  --shader-dir <dir>\n"
+            "                    Map .spv files from <dir> instead of the embedded shaders\n"
+            "  --timing-report <path>\n"
+            "                    Write per-phase timings as JSON to <path> (\"-\" for stdout)\n"
+            "  --help            Show this message\n"
+            "\n"
+            "Environment:\n"
+            "  CALYKO_VALIDATION       0 or 1, overridden by --validation/--no-validation\n"
+            "  CALYKO_DEVICE           Same as --device\n"
+            "  CALYKO_PIPELINE_CACHE   Pipeline cache path, empty to disable\n"
+            "  CALYKO_TUNING_FILE      Workgroup tuning file path, empty to disable\n"
+            "  CALYKO_SHADER_DIR       Same as --shader-dir\n"
+            "  CALYKO_TIMING_REPORT    Same as --timing-report\n",
+            program);
+}
+
+static bool parse_env_bool(const char *name, bool *out_value) {
+    const char *value = getenv(name);
+    if (!value || !*value) {
+        return true;
+    }
+
+    if (strcmp(value, "1") == 0 || strcmp(value, "on") == 0 || strcmp(value, "true") == 0) {
+        *out_value = true;
+        return true;
+    }
+
+    if (strcmp(value, "0") == 0 || strcmp(value, "off") == 0 || strcmp(value, "false") == 0) {
+        *out_value = false;
+        return true;
+    }
+
+    fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+    return false;
+}
+
+/* Returns the value following the option at argv[*i] and advances *i past it. */
+static const char *option_value(int argc, char **argv, int *i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return NULL;
+    }
+
+    *i += 1;
+    return argv[*i];
+}
+
+/* Parses a non-negative integer option value. */
+static bool parse_uint(const char *name, const char *value, uint32_t *out_value) {
+    if (!value) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || value[0] == '-' || parsed > UINT32_MAX) {
+        fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+        return false;
+    }
+
+    *out_value = (uint32_t)parsed;
+    return true;
+}
+
+/* Parses a positive integer option value. */
+static bool parse_positive_uint(const char *name, const char *value, uint32_t *out_value) {
+    uint32_t parsed;
+    if (!parse_uint(name, value, &parsed)) {
+        return false;
+    }
+
+    if (parsed == 0) {
+        fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+        return false;
+    }
+
+    *out_value = parsed;
+    return true;
+}
+
+/* Parses a <width>x<height> option value with both sides positive. */
+static bool parse_size(const char *name, const char *value, uint32_t *out_width,
+                       uint32_t *out_height) {
+    if (!value) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long width = strtoul(value, &end, 10);
+    if (errno == 0 && end != value && *end == 'x' && value[0] != '-' && width > 0 &&
+        width <= UINT32_MAX) {
+        const char *height_value = end + 1;
+        unsigned long height = strtoul(height_value, &end, 10);
+        if (errno == 0 && end != height_value && *end == '\0' && height_value[0] != '-' &&
+            height > 0 && height <= UINT32_MAX) {
+            *out_width = (uint32_t)width;
+            *out_height = (uint32_t)height;
+            return true;
+        }
+    }
+
+    fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+    return false;
+}
+
+/* Parses a non-negative decimal option value. */
+static bool parse_non_negative_double(const char *name, const char *value, double *out_value) {
+    if (!value) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    double parsed = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' || !(parsed >= 0.0)) {
+        fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+        return false;
+    }
+
+    *out_value = parsed;
+    return true;
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+    assert(options);
+
+    *options = (Options){
+        .validation = CALYKO_VALIDATION_DEFAULT,
+        .pipeline_cache_path = DEFAULT_PIPELINE_CACHE_PATH,
+        .tuning_path = DEFAULT_TUNING_PATH,
+        .width = 512,
+        .height = 512,
+        .frames = 1,
+        .passes = 1,
+        .preview_scale = DEFAULT_PREVIEW_SCALE,
+        .max_bounces = DEFAULT_MAX_BOUNCES,
+        .samples_per_dispatch = 1,
+        .slice_ms = DEFAULT_SLICE_MS,
+    };
+
+    if (!parse_env_bool("CALYKO_VALIDATION", &options->validation)) {
+        return false;
+    }
+
+    const char *env_device = getenv("CALYKO_DEVICE");
+    if (env_device && *env_device) {
+        options->device_selector = env_device;
+    }
+
+    const char *env_pipeline_cache = getenv("CALYKO_PIPELINE_CACHE");
+    if (env_pipeline_cache) {
+        options->pipeline_cache_path = *env_pipeline_cache ? env_pipeline_cache : NULL;
+    }
+
+    const char *env_tuning = getenv("CALYKO_TUNING_FILE");
+    if (env_tuning) {
+        options->tuning_path = *env_tuning ? env_tuning : NULL;
+    }
+
+    const char *env_shader_dir = getenv("CALYKO_SHADER_DIR");
+    if (env_shader_dir && *env_shader_dir) {
+        options->shader_dir = env_shader_dir;
+    }
+
+    const char *env_timing_report = getenv("CALYKO_TIMING_REPORT");
+    if (env_timing_report && *env_timing_report) {
+        options->timing_report_path = env_timing_report;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--validation") == 0) {
+            options->validation = true;
+        } else if (strcmp(arg, "--no-validation") == 0) {
+            options->validation = false;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            options->verbose = true;
+        } else if (strcmp(arg, "--device") == 0) {
+            options->device_selector = option_value(argc, argv, &i);
+            if (!options->device_selector) {
+                return false;
+            }
+        } else if (strcmp(arg, "--no-transfer-queue") == 0) {
+            options->disable_transfer_queue = true;
+        } else if (strcmp(arg, "--no-zero-copy") == 0) {
+            options->disable_zero_copy = true;
+        } else if (strcmp(arg, "--track-host-allocations") == 0) {
+            options->track_host_allocations = true;
+        } else if (strcmp(arg, "--serial-init") == 0) {
+            options->serial_init = true;
+        } else if (strcmp(arg, "--size") == 0) {
+            if (!parse_size(arg, option_value(argc, argv, &i), &options->width,
+                            &options->height)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--tile") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i), &options->tile_size)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--output-format") == 0) {
+            options->output_format = option_value(argc, argv, &i);
+            if (!options->output_format) {
+                return false;
+            }
+        } else if (strcmp(arg, "--frames") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i), &options->frames)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--sequence") == 0) {
+            options->sequence_path = option_value(argc, argv, &i);
+            if (!options->sequence_path) {
+                return false;
+            }
+        } else if (strcmp(arg, "--passes") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i), &options->passes)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--preview") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i),
+                                     &options->preview_passes)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--preview-scale") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i),
+                                     &options->preview_scale)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--bounces") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i), &options->max_bounces)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--samples-per-dispatch") == 0) {
+            if (!parse_positive_uint(arg, option_value(argc, argv, &i),
+                                     &options->samples_per_dispatch)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--scene") == 0) {
+            options->scene_features = option_value(argc, argv, &i);
+            if (!options->scene_features) {
+                return false;
+            }
+        } else if (strcmp(arg, "--seed") == 0) {
+            if (!parse_uint(arg, option_value(argc, argv, &i), &options->seed)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--rerecord-passes") == 0) {
+            options->rerecord_passes = true;
+        } else if (strcmp(arg, "--slice-ms") == 0) {
+            if (!parse_non_negative_double(arg, option_value(argc, argv, &i),
+                                           &options->slice_ms)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--pipeline-cache") == 0) {
+            options->pipeline_cache_path = option_value(argc, argv, &i);
+            if (!options->pipeline_cache_path) {
+                return false;
+            }
+        } else if (strcmp(arg, "--no-pipeline-cache") == 0) {
+            options->pipeline_cache_path = NULL;
+        } else if (strcmp(arg, "--autotune") == 0) {
+            options->autotune = true;
+        } else if (strcmp(arg, "--tuning-file") == 0) {
+            options->tuning_path = option_value(argc, argv, &i);
+            if (!options->tuning_path) {
+                return false;
+            }
+        } else if (strcmp(arg, "--shader-dir") == 0) {
+            options->shader_dir = option_value(argc, argv, &i);
+            if (!options->shader_dir) {
+                return false;
+            }
+        } else if (strcmp(arg, "--timing-report") == 0) {
+            options->timing_report_path = option_value(argc, argv, &i);
+            if (!options->timing_report_path) {
+                return false;
+            }
+        } else if (strcmp(arg, "--help") == 0) {
+            options->help = true;
+            print_usage(argv[0]);
+            return false;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,150 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define DEFAULT_TUNING_PATH "workgroup_tuning.txt"
+
+/* Tile size used when the output exceeds the device's image size limit and --tile is not given. */
+#define DEFAULT_TILE_SIZE 2048
+
+/* Preview downsampling used when --preview is given without --preview-scale. */
+#define DEFAULT_PREVIEW_SCALE 8
+
+/* Scattering events per path when --bounces is not given. */
+#define DEFAULT_MAX_BOUNCES 4
+
+/* Well below the two-second TDR delay on Windows and the similar Linux driver timeouts. */
+#define DEFAULT_SLICE_MS 10.0
+
+typedef struct Options {
+    /* Enables VK_LAYER_KHRONOS_validation and the VK_EXT_debug_utils messenger. Defaults to
+     * CALYKO_VALIDATION_DEFAULT and can be overridden with CALYKO_VALIDATION or the command line.
+     */
+    bool validation;
+
+    /* Prints startup diagnostics and forwards VERBOSE/INFO validation messages. */
+    bool verbose;
+
+    /* Physical device index, UUID or name; NULL picks the highest-ranked device. Set with --device
+     * or CALYKO_DEVICE.
+     */
+    const char *device_selector;
+
+    /* Keeps the readback on the compute queue even when a transfer-only queue family exists. Set
+     * with --no-transfer-queue.
+     */
+    bool disable_transfer_queue;
+
+    /* Packs frames into device memory and copies them back even when the GPU could write straight
+     * into host-visible device memory. Set with --no-zero-copy.
+     */
+    bool disable_zero_copy;
+
+    /* Routes Vulkan host allocations through a tracking arena and reports per-type usage. Set with
+     * --track-host-allocations.
+     */
+    bool track_host_allocations;
+
+    /* Compiles the pipeline on the main thread instead of overlapping it with resource setup.
+     * Set with --serial-init; useful for comparing time-to-first-dispatch.
+     */
+    bool serial_init;
+
+    /* Size of the output image. Set with --size <width>x<height>; defaults to 512x512. */
+    uint32_t width;
+    uint32_t height;
+
+    /* Renders the output in tiles of this many pixels square, reusing one tile-sized image and set
+     * of buffers, and writes it as PPM. When zero, only outputs larger than the device
+     * allows in one image are tiled, with DEFAULT_TILE_SIZE. Set with --tile.
+     */
+    uint32_t tile_size;
+
+    /* Name of the pixel format frames are read back and written in, or NULL for rgb8. Checked
+     * against the readback formats by main(). Set with --output-format.
+     */
+    const char *output_format;
+
+    /* Frames rendered in sequence, written to output_NNNN.png when more than one. Set with
+     * --frames.
+     */
+    uint32_t frames;
+
+    /* File of per-frame cameras, in the format load_sequence() reads, rendered back to back with
+     * one device, pipeline and set of buffers. Overrides --frames. Set with --sequence.
+     */
+    const char *sequence_path;
+
+    /* Sample passes accumulated per frame, each submitted separately. Set with --passes. */
+    uint32_t passes;
+
+    /* Passes between previews written to preview.png, or zero for none. Set with --preview. */
+    uint32_t preview_passes;
+
+    /* Previews are the frame downsampled by this factor on each axis. Defaults to
+     * DEFAULT_PREVIEW_SCALE; set with --preview-scale.
+     */
+    uint32_t preview_scale;
+
+    /* Compile-time settings of the path tracing kernel; each distinct combination is compiled
+     * once. Set with --bounces, --samples-per-dispatch and --scene, whose comma-separated feature
+     * names (or "none") main() checks against the PIPELINE_SCENE_* bits; NULL is "ground".
+     */
+    uint32_t max_bounces;
+    uint32_t samples_per_dispatch;
+    const char *scene_features;
+
+    /* Base seed of the random sequence. Set with --seed; defaults to zero. */
+    uint32_t seed;
+
+    /* Records the pass command buffers before every submission instead of replaying them, with
+     * the per-slice parameters as push constants. Set with --rerecord-passes; useful for comparing
+     * the host cost of a pass.
+     */
+    bool rerecord_passes;
+
+    /* GPU time to aim for per submission, in milliseconds; passes are split into slices of rows
+     * to match. Zero submits whole passes. Defaults to DEFAULT_SLICE_MS; set with --slice-ms.
+     */
+    double slice_ms;
+
+    /* Path of the on-disk pipeline cache, or NULL to compile without one. Defaults to
+     * DEFAULT_PIPELINE_CACHE_PATH and can be overridden with CALYKO_PIPELINE_CACHE.
+     */
+    const char *pipeline_cache_path;
+
+    /* Times a sweep of workgroup sizes before rendering, renders with the fastest and stores it
+     * in the tuning file. Set with --autotune.
+     */
+    bool autotune;
+
+    /* Path of the file of per-device workgroup sizes found by --autotune, which every run loads,
+     * or NULL to always use the default. Defaults to DEFAULT_TUNING_PATH; set with --tuning-file
+     * or CALYKO_TUNING_FILE.
+     */
+    const char *tuning_path;
+
+    /* Directory to load compiled .spv files from instead of the embedded copies, or NULL. Set with
+     * --shader-dir or CALYKO_SHADER_DIR.
+     */
+    const char *shader_dir;
+
+    /* Path to write the per-phase JSON timing report to ("-" for stdout), or NULL. Set with
+     * --timing-report or CALYKO_TIMING_REPORT.
+     */
+    const char *timing_report_path;
+
+    /* Set when --help was given; parse_options() then returns false. */
+    bool help;
+} Options;
+
+/* Fills `options` from the environment and then the command line, which takes precedence.
+ * Returns false if the program should exit, either because of an error or because usage was
+ * requested.
+ */
+bool parse_options(int argc, char **argv, Options *options);
+
+#endif /* OPTIONS_H */
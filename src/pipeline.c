@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,17 +10,36 @@
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan.h>
 
+#include "bindless.h"
 #include "device.h"
+#include "host_allocator.h"
+#include "pass_params.h"
+#include "shader.h"
+#include "shaders.h"
+#include "specialization.h"
+#include "timer.h"
 #include "utils.h"
 
-static VkDescriptorSetLayout create_descriptor_set_layout(VkDevice device) {
+static VkDescriptorSetLayout
+create_descriptor_set_layout(VkDevice device, const VkAllocationCallbacks *allocation_callbacks) {
     const VkDescriptorSetLayoutBinding bindings[] = {
+        /* Running sum of samples, alpha holds the sample count. The pack kernel turns it into
+         * the output.
+         */
         (VkDescriptorSetLayoutBinding){
             .binding = 0,
             .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
         },
+
+        /* Per-pass parameters; the offset selects the slot of the submission. */
+        (VkDescriptorSetLayoutBinding){
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
     };
 
     const VkDescriptorSetLayoutCreateInfo set_layout_info = {
@@ -29,7 +49,8 @@ static VkDescriptorSetLayout create_descriptor_set_layout(VkDevice device) {
     };
 
     VkDescriptorSetLayout layout;
-    VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &layout);
+    VkResult result =
+        vkCreateDescriptorSetLayout(device, &set_layout_info, allocation_callbacks, &layout);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "vkCreateDescriptorSetLayout() failed: %s\n", string_VkResult(result));
         return VK_NULL_HANDLE;
@@ -38,15 +59,30 @@ static VkDescriptorSetLayout create_descriptor_set_layout(VkDevice device) {
     return layout;
 }
 
-static VkPipelineLayout create_pipeline_layout(VkDevice device, VkDescriptorSetLayout set_layout) {
+static VkPipelineLayout create_pipeline_layout(VkDevice device,
+                                               const VkAllocationCallbacks *allocation_callbacks,
+                                               VkDescriptorSetLayout set_layout,
+                                               VkDescriptorSetLayout scene_set_layout) {
+    /* In set number order; SCENE_SET is 1. */
+    const VkDescriptorSetLayout set_layouts[] = {set_layout, scene_set_layout};
+
+    const VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(Pass_Params),
+    };
+
     const VkPipelineLayoutCreateInfo pipeline_layout_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pSetLayouts = &set_layout,
-        .setLayoutCount = 1,
+        .pSetLayouts = set_layouts,
+        .setLayoutCount = ARRAY_LEN(set_layouts),
+        .pPushConstantRanges = &push_constant_range,
+        .pushConstantRangeCount = 1,
     };
 
     VkPipelineLayout layout;
-    VkResult result = vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &layout);
+    VkResult result =
+        vkCreatePipelineLayout(device, &pipeline_layout_info, allocation_callbacks, &layout);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "vkCreatePipelineLayout failed: %s\n", string_VkResult(result));
         return VK_NULL_HANDLE;
@@ -55,58 +91,165 @@ static VkPipelineLayout create_pipeline_layout(VkDevice device, VkDescriptorSetL
     return layout;
 }
 
-static VkPipeline create_pipeline(VkDevice device, VkPipelineLayout layout,
-                                  const Pathtracing_Pipeline_Info *info) {
-    const VkSpecializationMapEntry entries[] = {
-        (VkSpecializationMapEntry){
-            .constantID = 0,
-            .offset = offsetof(Workgroup_Sizes, x),
-            sizeof(uint32_t),
-        },
+/* Constant ids 0 to 6 of pathtracer.comp. */
+static const Specialization_Constant pathtracing_constants[] = {
+    {0, offsetof(Pathtracing_Constants, workgroup_sizes) + offsetof(Workgroup_Sizes, x)},
+    {1, offsetof(Pathtracing_Constants, workgroup_sizes) + offsetof(Workgroup_Sizes, y)},
+    {2, offsetof(Pathtracing_Constants, workgroup_sizes) + offsetof(Workgroup_Sizes, z)},
+    {3, offsetof(Pathtracing_Constants, max_bounces)},
+    {4, offsetof(Pathtracing_Constants, samples_per_dispatch)},
+    {5, offsetof(Pathtracing_Constants, scene_features)},
+    {6, offsetof(Pathtracing_Constants, push_params)},
+};
 
-        (VkSpecializationMapEntry){
-            .constantID = 1,
-            .offset = offsetof(Workgroup_Sizes, y),
-            sizeof(uint32_t),
-        },
+static const struct {
+    const char *name;
+    uint32_t bit;
+} scene_features[] = {
+    {"ground", PIPELINE_SCENE_GROUND},
+    {"sun", PIPELINE_SCENE_SUN},
+};
 
-        (VkSpecializationMapEntry){
-            .constantID = 2,
-            .offset = offsetof(Workgroup_Sizes, y),
-            sizeof(uint32_t),
-        },
-    };
+bool parse_scene_features(const char *names, uint32_t *out_bits) {
+    assert(names);
+    assert(out_bits);
 
-    const VkSpecializationInfo specialization_info = {
-        .pMapEntries = entries,
-        .mapEntryCount = ARRAY_LEN(entries),
-        .dataSize = sizeof(Workgroup_Sizes),
-        .pData = &info->workgroup_sizes,
-    };
+    uint32_t bits = 0;
+    if (strcmp(names, "none") != 0) {
+        const char *name = names;
+        while (true) {
+            size_t length = strcspn(name, ",");
+            uint32_t i = 0;
+            while (i < ARRAY_LEN(scene_features) &&
+                   (strlen(scene_features[i].name) != length ||
+                    strncmp(name, scene_features[i].name, length) != 0)) {
+                i++;
+            }
+
+            if (i == ARRAY_LEN(scene_features)) {
+                fprintf(stderr, "Unknown scene feature: %.*s\n", (int)length, name);
+                return false;
+            }
+
+            bits |= scene_features[i].bit;
+            if (name[length] == '\0') {
+                break;
+            }
+
+            name += length + 1;
+        }
+    }
+
+    *out_bits = bits;
+    return true;
+}
+
+/* A kernel's module: loaded from `file_name` in the shader override directory when there is one,
+ * and otherwise from the SPIR-V the build embedded.
+ */
+typedef struct Kernel_Source {
+    const char *file_name;
+    const uint32_t *code;
+    const size_t *size;
+} Kernel_Source;
+
+/* Every kernel in Kernel_Id, in its fixed-layout build and its BINDLESS build. */
+static const struct {
+    const char *name;
+    Kernel_Source fixed;
+    Kernel_Source bindless;
+} kernels[KERNEL_COUNT] = {
+    [KERNEL_PATHTRACE] = {"pathtrace",
+                          {"pathtracer.comp.spv", pathtracer_comp_spv, &pathtracer_comp_spv_size},
+                          {"pathtracer_bindless.comp.spv", pathtracer_bindless_comp_spv,
+                           &pathtracer_bindless_comp_spv_size}},
+};
+
+const char *kernel_name(Kernel_Id kernel) {
+    assert(kernel < KERNEL_COUNT);
+    return kernels[kernel].name;
+}
+
+static VkPipeline create_pipeline(VkDevice device,
+                                  const VkAllocationCallbacks *allocation_callbacks,
+                                  const Pathtracing_Pipeline *pipeline, Kernel_Id kernel,
+                                  const Pathtracing_Constants *constants) {
+    Specialization specialization;
+    init_specialization(pathtracing_constants, ARRAY_LEN(pathtracing_constants), constants,
+                        sizeof(*constants), &specialization);
 
     const VkPipelineShaderStageCreateInfo shader_stage_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .module = info->compute_shader,
+        .module = pipeline->shaders[kernel],
         .stage = VK_SHADER_STAGE_COMPUTE_BIT,
         .pName = "main",
-        .pSpecializationInfo = &specialization_info,
+        .pSpecializationInfo = &specialization.info,
     };
 
     const VkComputePipelineCreateInfo compute_pipeline_info = {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .layout = layout,
+        .layout = pipeline->layout,
         .stage = shader_stage_info,
     };
 
-    VkPipeline pipeline;
-    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &compute_pipeline_info,
-                                               NULL, &pipeline);
+    VkPipeline vk_pipeline;
+    VkResult result = vkCreateComputePipelines(device, pipeline->pipeline_cache, 1,
+                                               &compute_pipeline_info, allocation_callbacks,
+                                               &vk_pipeline);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "vkCreateComputePipelines() failed: %s\n", string_VkResult(result));
         return VK_NULL_HANDLE;
     }
 
-    return pipeline;
+    return vk_pipeline;
+}
+
+VkPipeline get_kernel_variant(const Device *device, Pathtracing_Pipeline *pipeline,
+                              Kernel_Id kernel, const Pathtracing_Constants *constants) {
+    assert(device);
+    assert(pipeline);
+    assert(kernel < KERNEL_COUNT);
+    assert(constants);
+
+    uint64_t hash = hash_specialization(constants, sizeof(*constants)) ^ kernel;
+
+    for (uint32_t i = 0; i < pipeline->variant_count; i++) {
+        const Pathtracing_Variant *variant = &pipeline->variants[i];
+        if (variant->hash == hash && variant->kernel == kernel &&
+            memcmp(&variant->constants, constants, sizeof(*constants)) == 0) {
+            return variant->pipeline;
+        }
+    }
+
+    if (pipeline->variant_count == PIPELINE_MAX_VARIANTS) {
+        fprintf(stderr, "All %u pipeline variants are in use\n", PIPELINE_MAX_VARIANTS);
+        return VK_NULL_HANDLE;
+    }
+
+    uint64_t start_ns = timer_now_ns();
+    VkPipeline vk_pipeline = create_pipeline(
+        device->device, host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE),
+        pipeline, kernel, constants);
+    if (!vk_pipeline) {
+        fprintf(stderr, "create_pipeline() failed for kernel %s\n", kernel_name(kernel));
+        return VK_NULL_HANDLE;
+    }
+
+    pipeline->variants[pipeline->variant_count++] = (Pathtracing_Variant){
+        .hash = hash,
+        .kernel = kernel,
+        .constants = *constants,
+        .pipeline = vk_pipeline,
+        .creation_ms = timer_ms_between(start_ns, timer_now_ns()),
+    };
+
+    return vk_pipeline;
+}
+
+VkPipeline get_kernel(const Pathtracing_Pipeline *pipeline, Kernel_Id kernel) {
+    assert(pipeline);
+    assert(kernel < KERNEL_COUNT);
+    return pipeline->kernels[kernel];
 }
 
 bool create_pathtracing_pipeline(const Device *device, const Pathtracing_Pipeline_Info *info,
@@ -115,29 +258,83 @@ bool create_pathtracing_pipeline(const Device *device, const Pathtracing_Pipelin
     assert(info);
     assert(pipeline);
 
-    pipeline->descriptor_set_layout = create_descriptor_set_layout(device->device);
+    *pipeline = (Pathtracing_Pipeline){
+        .pipeline_cache = info->pipeline_cache,
+    };
+
+    const VkAllocationCallbacks *allocation_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE);
+
+    pipeline->descriptor_set_layout =
+        create_descriptor_set_layout(device->device, allocation_callbacks);
     if (!pipeline->descriptor_set_layout) {
         fprintf(stderr, "create_descriptor_set_layout() failed\n");
         return false;
     }
 
-    pipeline->layout = create_pipeline_layout(device->device, pipeline->descriptor_set_layout);
+    if (!create_bindless_layout(device, &pipeline->scene_layout)) {
+        fprintf(stderr, "create_bindless_layout() failed\n");
+        return false;
+    }
+
+    pipeline->layout =
+        create_pipeline_layout(device->device, allocation_callbacks,
+                               pipeline->descriptor_set_layout, pipeline->scene_layout.set_layout);
     if (!pipeline->layout) {
         fprintf(stderr, "create_pipeline_layout() failed\n");
         return false;
     }
 
-    pipeline->pipeline = create_pipeline(device->device, pipeline->layout, info);
-    if (!pipeline->pipeline) {
-        fprintf(stderr, "create_pipeline() failed\n");
-        return false;
+    const VkAllocationCallbacks *shader_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_SHADER);
+
+    for (uint32_t i = 0; i < KERNEL_COUNT; i++) {
+        const Kernel_Source *kernel =
+            pipeline->scene_layout.bindless ? &kernels[i].bindless : &kernels[i].fixed;
+        const Shader_Source source = {
+            .name = kernel->file_name,
+            .code = kernel->code,
+            .size = *kernel->size,
+        };
+
+        pipeline->shaders[i] =
+            create_shader_module(device->device, shader_callbacks, &source, info->shader_dir);
+        if (!pipeline->shaders[i]) {
+            fprintf(stderr, "create_shader_module() failed for kernel %s\n",
+                    kernel_name((Kernel_Id)i));
+            return false;
+        }
+
+        pipeline->kernels[i] =
+            get_kernel_variant(device, pipeline, (Kernel_Id)i, &info->constants);
+        if (!pipeline->kernels[i]) {
+            fprintf(stderr, "get_kernel_variant() failed\n");
+            return false;
+        }
+
+        pipeline->creation_ms += pipeline->variants[pipeline->variant_count - 1].creation_ms;
     }
 
+    pipeline->constants = pipeline->variants[0].constants;
     return true;
 }
 
 void destroy_pathtracing_pipeline(const Device *device, Pathtracing_Pipeline *pipeline) {
-    vkDestroyPipeline(device->device, pipeline->pipeline, NULL);
-    vkDestroyPipelineLayout(device->device, pipeline->layout, NULL);
-    vkDestroyDescriptorSetLayout(device->device, pipeline->descriptor_set_layout, NULL);
+    const VkAllocationCallbacks *allocation_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE);
+    const VkAllocationCallbacks *shader_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_SHADER);
+
+    for (uint32_t i = 0; i < pipeline->variant_count; i++) {
+        vkDestroyPipeline(device->device, pipeline->variants[i].pipeline, allocation_callbacks);
+    }
+
+    for (uint32_t i = 0; i < KERNEL_COUNT; i++) {
+        vkDestroyShaderModule(device->device, pipeline->shaders[i], shader_callbacks);
+    }
+
+    vkDestroyPipelineLayout(device->device, pipeline->layout, allocation_callbacks);
+    destroy_bindless_layout(device, &pipeline->scene_layout);
+    vkDestroyDescriptorSetLayout(device->device, pipeline->descriptor_set_layout,
+                                 allocation_callbacks);
 }
@@ -4,6 +4,7 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
 
+#include "bindless.h"
 #include "device.h"
 
 typedef struct Workgroup_Sizes {
@@ -12,19 +13,122 @@ typedef struct Workgroup_Sizes {
     uint32_t z;
 } Workgroup_Sizes;
 
-typedef struct Pathtracing_Pipeline_Info {
-    VkShaderModule compute_shader;
+/* Bits of the SCENE_FEATURES specialization constant (constant_id 5): the light and material code
+ * a variant contains. Code for a clear bit is compiled out rather than branched around.
+ */
+#define PIPELINE_SCENE_GROUND (1u << 0) /* Diffuse ground plane below the camera. */
+#define PIPELINE_SCENE_SUN (1u << 1)    /* Directional sun disc in the sky. */
+
+/* Parses a comma-separated list of scene feature names ("ground", "sun"), or "none", into
+ * PIPELINE_SCENE_* bits. Returns false if a name is unknown.
+ */
+bool parse_scene_features(const char *names, uint32_t *out_bits);
+
+/* Every compile-time constant of pathtracer.comp, in constant_id order. Only 32-bit fields, so
+ * equal values hash equally.
+ */
+typedef struct Pathtracing_Constants {
     Workgroup_Sizes workgroup_sizes;
+
+    /* Scattering events followed per path before it is terminated. */
+    uint32_t max_bounces;
+
+    /* Samples each invocation takes per pixel before adding them to the accumulation image. */
+    uint32_t samples_per_dispatch;
+
+    /* PIPELINE_SCENE_* bits. */
+    uint32_t scene_features;
+
+    /* VK_TRUE to read Pass_Params from push constants instead of the slice parameter buffer.
+     * Push constants are recorded into the command buffer, so only passes recorded per slice can
+     * use them.
+     */
+    uint32_t push_params;
+} Pathtracing_Constants;
+
+/* The compute kernels of the path tracer. Every kernel is built from its own shader module
+ * against the one pipeline layout, so each can be bound with the same descriptor sets and
+ * Pass_Params, and a renderer made of several stages, such as a wavefront path tracer's generate,
+ * extend, shade and accumulate kernels, only needs an ID and a shader per stage.
+ */
+typedef enum Kernel_Id {
+    /* The whole path, from camera ray to accumulation, in one dispatch (pathtracer.comp). */
+    KERNEL_PATHTRACE,
+
+    KERNEL_COUNT,
+} Kernel_Id;
+
+/* Name of the kernel for diagnostics, also the base name of its .spv file. */
+const char *kernel_name(Kernel_Id kernel);
+
+typedef struct Pathtracing_Pipeline_Info {
+    /* Directory to load the kernels' .spv files from instead of the embedded copies, or NULL. */
+    const char *shader_dir;
+
+    /* Constants of the variants compiled up front, one per kernel. */
+    Pathtracing_Constants constants;
+
+    /* Optional; VK_NULL_HANDLE compiles without a cache. */
+    VkPipelineCache pipeline_cache;
 } Pathtracing_Pipeline_Info;
 
+/* Distinct (kernel, constants) pairs one Pathtracing_Pipeline can hold compiled at once; enough
+ * for the autotune sweep, which compiles one per workgroup size candidate.
+ */
+#define PIPELINE_MAX_VARIANTS 64
+
+typedef struct Pathtracing_Variant {
+    uint64_t hash;
+    Kernel_Id kernel;
+    Pathtracing_Constants constants;
+    VkPipeline pipeline;
+
+    /* Time spent in vkCreateComputePipelines(), i.e. the cost of a cache hit or miss. */
+    double creation_ms;
+} Pathtracing_Variant;
+
+/* Registry of the path tracing kernels: the layouts they share, their shader modules and every
+ * variant of them compiled so far. Switching kernels or variants only rebinds the pipeline.
+ *
+ * Set 0 holds the renderer's accumulation image and parameters, and set 1 the scene's resources
+ * in `scene_layout`. With descriptor indexing the kernels are loaded in their BINDLESS build,
+ * which sees the scene arrays as runtime arrays.
+ */
 typedef struct Pathtracing_Pipeline {
     VkDescriptorSetLayout descriptor_set_layout;
+    Bindless_Layout scene_layout;
     VkPipelineLayout layout;
-    VkPipeline pipeline;
+
+    VkShaderModule shaders[KERNEL_COUNT];
+
+    /* Kept for compiling variants later; owned by the caller. */
+    VkPipelineCache pipeline_cache;
+
+    /* Each kernel's variant for the info's constants. Look these up with get_kernel(). */
+    VkPipeline kernels[KERNEL_COUNT];
+    Pathtracing_Constants constants;
+
+    /* Time spent compiling `kernels`. */
+    double creation_ms;
+
+    /* In-process variant cache, looked up by hash of the kernel and constants. */
+    Pathtracing_Variant variants[PIPELINE_MAX_VARIANTS];
+    uint32_t variant_count;
 } Pathtracing_Pipeline;
 
+/* Loads every kernel in Kernel_Id and compiles it with the info's constants. */
 bool create_pathtracing_pipeline(const Device *device, const Pathtracing_Pipeline_Info *info,
                                  Pathtracing_Pipeline *pipeline);
 void destroy_pathtracing_pipeline(const Device *device, Pathtracing_Pipeline *pipeline);
 
+/* The variant of `kernel` compiled by create_pathtracing_pipeline(). */
+VkPipeline get_kernel(const Pathtracing_Pipeline *pipeline, Kernel_Id kernel);
+
+/* Returns the variant of `kernel` specialised with `constants`, compiling it on first use, or
+ * VK_NULL_HANDLE on failure. Variants live until the pipeline is destroyed, and a renderer
+ * dispatches one through set_renderer_kernel(). Not thread-safe.
+ */
+VkPipeline get_kernel_variant(const Device *device, Pathtracing_Pipeline *pipeline,
+                              Kernel_Id kernel, const Pathtracing_Constants *constants);
+
 #endif /* PIPELINE_H */
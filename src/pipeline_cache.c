@@ -0,0 +1,263 @@
+#include "pipeline_cache.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "atomic_file.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "timer.h"
+
+#define PIPELINE_CACHE_MAGIC 0x4b594c43u /* "CLYK" */
+#define PIPELINE_CACHE_FILE_VERSION 1u
+
+/* Prepended to the driver's blob. The driver validates its own header too, but some drivers
+ * accept blobs from older driver versions and silently discard them, so the driver version is
+ * checked here as well.
+ */
+typedef struct Pipeline_Cache_File_Header {
+    uint32_t magic;
+    uint32_t file_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+} Pipeline_Cache_File_Header;
+
+static uint64_t hash_bytes(const void *data, size_t size) {
+    /* 64-bit FNV-1a; enough to catch truncated or partially written files. */
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static Pipeline_Cache_File_Header make_file_header(const Physical_Device_Info *info) {
+    Pipeline_Cache_File_Header header = {
+        .magic = PIPELINE_CACHE_MAGIC,
+        .file_version = PIPELINE_CACHE_FILE_VERSION,
+        .vendor_id = info->properties.vendorID,
+        .device_id = info->properties.deviceID,
+        .driver_version = info->properties.driverVersion,
+    };
+
+    memcpy(header.pipeline_cache_uuid, info->properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+/* Returns NULL if `data` is usable as initial data for this device, otherwise the reason. */
+static const char *validate_cache_data(const Physical_Device_Info *info,
+                                       const Pipeline_Cache_File_Header *header, const void *data) {
+    const Pipeline_Cache_File_Header expected = make_file_header(info);
+    if (header->magic != expected.magic || header->file_version != expected.file_version) {
+        return "unrecognised file";
+    }
+
+    if (header->vendor_id != expected.vendor_id || header->device_id != expected.device_id) {
+        return "different device";
+    }
+
+    if (header->driver_version != expected.driver_version) {
+        return "different driver version";
+    }
+
+    if (memcmp(header->pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE) != 0) {
+        return "different pipeline cache UUID";
+    }
+
+    if (hash_bytes(data, (size_t)header->data_size) != header->data_hash) {
+        return "checksum mismatch";
+    }
+
+    VkPipelineCacheHeaderVersionOne vk_header;
+    if (header->data_size < sizeof(vk_header)) {
+        return "truncated driver header";
+    }
+
+    memcpy(&vk_header, data, sizeof(vk_header));
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vk_header.vendorID != expected.vendor_id || vk_header.deviceID != expected.device_id ||
+        memcmp(vk_header.pipelineCacheUUID, expected.pipeline_cache_uuid, VK_UUID_SIZE) != 0) {
+        return "driver header mismatch";
+    }
+
+    return NULL;
+}
+
+/* Reads the cache file into a malloc'd buffer. Returns NULL and sets `miss_reason` if the file is
+ * missing or unusable.
+ */
+static void *read_cache_file(const Physical_Device_Info *info, const char *path, size_t *out_size,
+                             const char **miss_reason) {
+    *out_size = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        *miss_reason = "no cache file";
+        return NULL;
+    }
+
+    Pipeline_Cache_File_Header header;
+    if (fread(&header, sizeof(header), 1, file) != 1) {
+        *miss_reason = "truncated file header";
+        fclose(file);
+        return NULL;
+    }
+
+    /* Guard against absurd sizes before trusting the header enough to allocate. */
+    if (header.data_size == 0 || header.data_size > (uint64_t)256 * 1024 * 1024) {
+        *miss_reason = "invalid data size";
+        fclose(file);
+        return NULL;
+    }
+
+    size_t data_size = (size_t)header.data_size;
+    void *data = malloc(data_size);
+    if (!data) {
+        *miss_reason = "out of memory";
+        fclose(file);
+        return NULL;
+    }
+
+    if (fread(data, 1, data_size, file) != data_size) {
+        *miss_reason = "truncated data";
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+
+    *miss_reason = validate_cache_data(info, &header, data);
+    if (*miss_reason) {
+        free(data);
+        return NULL;
+    }
+
+    *out_size = data_size;
+    return data;
+}
+
+bool create_pipeline_cache(const Device *device, const char *path, Pipeline_Cache *cache) {
+    assert(device);
+    assert(cache);
+
+    *cache = (Pipeline_Cache){
+        .path = path,
+    };
+
+    if (!path) {
+        cache->stats.miss_reason = "disabled";
+        return true;
+    }
+
+    uint64_t start_ns = timer_now_ns();
+
+    size_t data_size;
+    void *data = read_cache_file(&device->info, path, &data_size, &cache->stats.miss_reason);
+
+    const VkPipelineCacheCreateInfo cache_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data_size,
+        .pInitialData = data,
+    };
+
+    cache->stats.hit = data != NULL;
+
+    VkResult result = vkCreatePipelineCache(
+        device->device, &cache_info,
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE), &cache->cache);
+    free(data);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreatePipelineCache() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    cache->stats.loaded_bytes = data_size;
+    cache->stats.load_ms = timer_ms_between(start_ns, timer_now_ns());
+    return true;
+}
+
+bool save_pipeline_cache(const Device *device, Pipeline_Cache *cache) {
+    assert(device);
+    assert(cache);
+
+    if (!cache->cache) {
+        return true;
+    }
+
+    uint64_t start_ns = timer_now_ns();
+
+    size_t data_size = 0;
+    VkResult result = vkGetPipelineCacheData(device->device, cache->cache, &data_size, NULL);
+    if (result != VK_SUCCESS || data_size == 0) {
+        fprintf(stderr, "vkGetPipelineCacheData() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    /* Nothing new was compiled; skip rewriting an identical file on every run. */
+    if (cache->stats.hit && data_size == cache->stats.loaded_bytes) {
+        return true;
+    }
+
+    void *data = malloc(data_size);
+    if (!data) {
+        perror("malloc failed");
+        return false;
+    }
+
+    result = vkGetPipelineCacheData(device->device, cache->cache, &data_size, data);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkGetPipelineCacheData() failed: %s\n", string_VkResult(result));
+        free(data);
+        return false;
+    }
+
+    Pipeline_Cache_File_Header header = make_file_header(&device->info);
+    header.data_size = data_size;
+    header.data_hash = hash_bytes(data, data_size);
+
+    char *tmp_path;
+    FILE *file = create_temp_file(cache->path, &tmp_path);
+    if (!file) {
+        fprintf(stderr, "create_temp_file() failed\n");
+        free(data);
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(data, 1, data_size, file) == data_size;
+    written = fclose(file) == 0 && written;
+    free(data);
+
+    if (!written || !replace_file(tmp_path, cache->path)) {
+        fprintf(stderr, "Failed to write pipeline cache to %s\n", cache->path);
+        remove(tmp_path);
+        free(tmp_path);
+        return false;
+    }
+
+    free(tmp_path);
+
+    cache->stats.saved_bytes = data_size;
+    cache->stats.save_ms = timer_ms_between(start_ns, timer_now_ns());
+    return true;
+}
+
+void destroy_pipeline_cache(const Device *device, Pipeline_Cache *cache) {
+    vkDestroyPipelineCache(device->device, cache->cache,
+                           host_allocator_callbacks(device->host_allocator,
+                                                    HOST_ALLOCATION_PIPELINE));
+}
@@ -0,0 +1,45 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+typedef struct Pipeline_Cache_Stats {
+    /* True when a blob from disk matched this device and driver and seeded the cache. */
+    bool hit;
+
+    /* Why the blob on disk was not used, or NULL on a hit. */
+    const char *miss_reason;
+
+    size_t loaded_bytes;
+    size_t saved_bytes;
+
+    double load_ms;
+    double save_ms;
+} Pipeline_Cache_Stats;
+
+typedef struct Pipeline_Cache {
+    /* VK_NULL_HANDLE when caching is disabled; pipelines are then compiled from scratch. */
+    VkPipelineCache cache;
+
+    const char *path;
+    Pipeline_Cache_Stats stats;
+} Pipeline_Cache;
+
+/* Creates a pipeline cache seeded from `path` if the file exists and was written by the same
+ * device (vendor ID, device ID, pipelineCacheUUID) and driver version. Any mismatch or corrupt
+ * file results in an empty cache, not an error. A NULL `path` disables caching.
+ */
+bool create_pipeline_cache(const Device *device, const char *path, Pipeline_Cache *cache);
+
+/* Writes the cache contents back to disk. The file is written to a temporary path and renamed
+ * over the old one, so a crash never leaves a truncated cache behind.
+ */
+bool save_pipeline_cache(const Device *device, Pipeline_Cache *cache);
+
+void destroy_pipeline_cache(const Device *device, Pipeline_Cache *cache);
+
+#endif /* PIPELINE_CACHE_H */
@@ -0,0 +1,219 @@
+#include "profile.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "timer.h"
+
+void profile_init(Profile *profile) {
+    assert(profile);
+
+    *profile = (Profile){
+        .origin_ns = timer_now_ns(),
+    };
+}
+
+void profile_begin(Profile *profile, const char *name) {
+    assert(profile);
+    assert(name);
+
+    /* A phase that does not fit is counted instead, and so is everything nested in it, which has
+     * no parent to nest under. The matching profile_end() then closes nothing.
+     */
+    if (profile->dropped_open || profile->phase_count >= PROFILE_MAX_PHASES ||
+        profile->open_count >= PROFILE_MAX_DEPTH) {
+        profile->dropped_phases++;
+        profile->dropped_open++;
+        return;
+    }
+
+    uint32_t index = profile->phase_count++;
+    profile->phases[index] = (Profile_Phase){
+        .name = name,
+        .depth = profile->open_count,
+        .start_ns = timer_now_ns(),
+    };
+
+    profile->open_phases[profile->open_count++] = index;
+}
+
+void profile_end(Profile *profile) {
+    assert(profile);
+    if (profile->dropped_open) {
+        profile->dropped_open--;
+        return;
+    }
+
+    assert(profile->open_count > 0);
+    if (profile->open_count == 0) {
+        return;
+    }
+
+    uint32_t index = profile->open_phases[--profile->open_count];
+    profile->phases[index].end_ns = timer_now_ns();
+}
+
+void profile_merge(Profile *profile, const Profile *source) {
+    assert(profile);
+    assert(source);
+
+    uint32_t depth = profile->open_count;
+    profile->dropped_phases += source->dropped_phases;
+    for (uint32_t i = 0; i < source->phase_count; i++) {
+        if (profile->phase_count >= PROFILE_MAX_PHASES) {
+            profile->dropped_phases += source->phase_count - i;
+            return;
+        }
+
+        Profile_Phase phase = source->phases[i];
+        phase.depth += depth;
+        profile->phases[profile->phase_count++] = phase;
+    }
+}
+
+double profile_phase_ms(const Profile *profile, const char *name) {
+    for (uint32_t i = profile->phase_count; i > 0; i--) {
+        const Profile_Phase *phase = &profile->phases[i - 1];
+        if (phase->end_ns && strcmp(phase->name, name) == 0) {
+            return timer_ms_between(phase->start_ns, phase->end_ns);
+        }
+    }
+
+    return 0.0;
+}
+
+static Profile_Attribute *find_or_add_attribute(Profile *profile, const char *name) {
+    for (uint32_t i = 0; i < profile->attribute_count; i++) {
+        if (strcmp(profile->attributes[i].name, name) == 0) {
+            return &profile->attributes[i];
+        }
+    }
+
+    /* A lost attribute makes the report incomplete, which writing it checks. */
+    if (profile->attribute_count >= PROFILE_MAX_ATTRIBUTES) {
+        profile->dropped_attributes++;
+        return NULL;
+    }
+
+    Profile_Attribute *attribute = &profile->attributes[profile->attribute_count++];
+    attribute->name = name;
+    return attribute;
+}
+
+void profile_set_number(Profile *profile, const char *name, double value) {
+    Profile_Attribute *attribute = find_or_add_attribute(profile, name);
+    if (attribute) {
+        attribute->string = NULL;
+        attribute->number = value;
+    }
+}
+
+void profile_set_string(Profile *profile, const char *name, const char *value) {
+    Profile_Attribute *attribute = find_or_add_attribute(profile, name);
+    if (attribute) {
+        attribute->string = value;
+    }
+}
+
+static void write_json_string(FILE *file, const char *string) {
+    fputc('"', file);
+    for (const char *c = string; *c; c++) {
+        switch (*c) {
+        case '"':
+            fputs("\\\"", file);
+            break;
+        case '\\':
+            fputs("\\\\", file);
+            break;
+        case '\n':
+            fputs("\\n", file);
+            break;
+        case '\t':
+            fputs("\\t", file);
+            break;
+        default:
+            if ((unsigned char)*c < 0x20) {
+                fprintf(file, "\\u%04x", (unsigned)(unsigned char)*c);
+            } else {
+                fputc(*c, file);
+            }
+            break;
+        }
+    }
+    fputc('"', file);
+}
+
+bool profile_write_json(const Profile *profile, const char *path) {
+    assert(profile);
+    assert(path);
+
+    if (profile->dropped_attributes) {
+        fprintf(stderr, "%u attributes did not fit in PROFILE_MAX_ATTRIBUTES (%u)\n",
+                profile->dropped_attributes, PROFILE_MAX_ATTRIBUTES);
+        return false;
+    }
+
+    if (profile->dropped_phases) {
+        fprintf(stderr, "%u phases did not fit in PROFILE_MAX_PHASES (%u) or PROFILE_MAX_DEPTH (%u)"
+                        "\n",
+                profile->dropped_phases, PROFILE_MAX_PHASES, PROFILE_MAX_DEPTH);
+        return false;
+    }
+
+    bool to_stdout = strcmp(path, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    /* A phase left open by an early exit is reported as ending now. */
+    uint64_t now_ns = timer_now_ns();
+    uint64_t end_ns = profile->origin_ns;
+    for (uint32_t i = 0; i < profile->phase_count; i++) {
+        uint64_t phase_end_ns = profile->phases[i].end_ns ? profile->phases[i].end_ns : now_ns;
+        if (phase_end_ns > end_ns) {
+            end_ns = phase_end_ns;
+        }
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"total_ms\": %.6f,\n", timer_ms_between(profile->origin_ns, end_ns));
+
+    fprintf(file, "  \"attributes\": {");
+    for (uint32_t i = 0; i < profile->attribute_count; i++) {
+        const Profile_Attribute *attribute = &profile->attributes[i];
+        fprintf(file, "%s\n    ", i == 0 ? "" : ",");
+        write_json_string(file, attribute->name);
+        fprintf(file, ": ");
+        if (attribute->string) {
+            write_json_string(file, attribute->string);
+        } else {
+            fprintf(file, "%.17g", attribute->number);
+        }
+    }
+    fprintf(file, "%s},\n", profile->attribute_count ? "\n  " : "");
+
+    fprintf(file, "  \"phases\": [");
+    for (uint32_t i = 0; i < profile->phase_count; i++) {
+        const Profile_Phase *phase = &profile->phases[i];
+        uint64_t phase_end_ns = phase->end_ns ? phase->end_ns : now_ns;
+
+        fprintf(file, "%s\n    {\"name\": ", i == 0 ? "" : ",");
+        write_json_string(file, phase->name);
+        fprintf(file, ", \"depth\": %u, \"start_ms\": %.6f, \"duration_ms\": %.6f}", phase->depth,
+                timer_ms_between(profile->origin_ns, phase->start_ns),
+                timer_ms_between(phase->start_ns, phase_end_ns));
+    }
+    fprintf(file, "%s]\n", profile->phase_count ? "\n  " : "");
+    fprintf(file, "}\n");
+
+    if (to_stdout) {
+        return fflush(file) == 0;
+    }
+
+    return fclose(file) == 0;
+}
@@ -0,0 +1,73 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_MAX_PHASES 128
+#define PROFILE_MAX_DEPTH 8
+#define PROFILE_MAX_ATTRIBUTES 64
+
+typedef struct Profile_Phase {
+    const char *name;
+    uint32_t depth;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} Profile_Phase;
+
+typedef struct Profile_Attribute {
+    const char *name;
+    const char *string; /* NULL for numeric attributes. */
+    double number;
+} Profile_Attribute;
+
+/* Records wall-clock phases against a monotonic clock. Phases nest: profile_end() closes the most
+ * recently opened phase. Names and string attributes are not copied and must outlive the profile.
+ */
+typedef struct Profile {
+    uint64_t origin_ns;
+
+    Profile_Phase phases[PROFILE_MAX_PHASES];
+    uint32_t phase_count;
+
+    uint32_t open_phases[PROFILE_MAX_DEPTH];
+    uint32_t open_count;
+
+    /* Phases begun after every slot or level was taken, and how many of them are still open;
+     * profile_write_json() refuses to write a report missing them.
+     */
+    uint32_t dropped_phases;
+    uint32_t dropped_open;
+
+    Profile_Attribute attributes[PROFILE_MAX_ATTRIBUTES];
+    uint32_t attribute_count;
+
+    /* Attributes set after every slot was taken; profile_write_json() refuses to write a report
+     * missing them.
+     */
+    uint32_t dropped_attributes;
+} Profile;
+
+void profile_init(Profile *profile);
+
+void profile_begin(Profile *profile, const char *name);
+void profile_end(Profile *profile);
+
+/* Appends the phases of `source`, typically recorded on another thread, nested under the phase
+ * currently open in `profile`. Phases keep their own timestamps, so overlapping work shows up as
+ * overlapping intervals. Attributes are not copied.
+ */
+void profile_merge(Profile *profile, const Profile *source);
+
+/* Returns the duration of the most recent phase called `name`, or 0 if there is none. */
+double profile_phase_ms(const Profile *profile, const char *name);
+
+void profile_set_number(Profile *profile, const char *name, double value);
+void profile_set_string(Profile *profile, const char *name, const char *value);
+
+/* Writes the profile as JSON to `path`, or to stdout if `path` is "-". Fails without writing
+ * anything if a phase or attribute did not fit.
+ */
+bool profile_write_json(const Profile *profile, const char *path);
+
+#endif /* PROFILE_H */
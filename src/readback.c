@@ -0,0 +1,249 @@
+#include "readback.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "host_allocator.h"
+#include "specialization.h"
+#include "utils.h"
+
+/* Must match local_size_x in pack.comp. */
+#define PACK_WORKGROUP_SIZE 64
+
+static const struct {
+    const char *name;
+    uint32_t pixel_size;
+} readback_formats[READBACK_FORMAT_COUNT] = {
+    [READBACK_FORMAT_RGBA8] = {"rgba8", 4},
+    [READBACK_FORMAT_RGB8] = {"rgb8", 3},
+    [READBACK_FORMAT_RGBA16F] = {"rgba16f", 8},
+    [READBACK_FORMAT_RGBA32F] = {"rgba32f", 16},
+    [READBACK_FORMAT_R11G11B10F] = {"r11g11b10f", 4},
+};
+
+Readback_Layout get_readback_layout(Readback_Format format, uint32_t width, uint32_t height,
+                                    uint32_t row_alignment) {
+    assert(format < READBACK_FORMAT_COUNT);
+    assert(row_alignment && (row_alignment & (row_alignment - 1)) == 0);
+
+    if (row_alignment < 4) {
+        row_alignment = 4;
+    }
+
+    uint32_t pixel_size = readback_formats[format].pixel_size;
+    uint32_t row_pitch = (width * pixel_size + row_alignment - 1) & ~(row_alignment - 1);
+
+    return (Readback_Layout){
+        .format = format,
+        .width = width,
+        .height = height,
+        .pixel_size = pixel_size,
+        .row_pitch = row_pitch,
+        .size = (VkDeviceSize)row_pitch * height,
+    };
+}
+
+const char *readback_format_name(Readback_Format format) {
+    assert(format < READBACK_FORMAT_COUNT);
+    return readback_formats[format].name;
+}
+
+bool find_readback_format(const char *name, Readback_Format *out_format) {
+    assert(name);
+    assert(out_format);
+
+    for (uint32_t i = 0; i < READBACK_FORMAT_COUNT; i++) {
+        if (strcmp(name, readback_formats[i].name) == 0) {
+            *out_format = (Readback_Format)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static VkDescriptorSetLayout
+create_descriptor_set_layout(VkDevice device, const VkAllocationCallbacks *allocation_callbacks) {
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        (VkDescriptorSetLayoutBinding){
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+
+        (VkDescriptorSetLayoutBinding){
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+
+    const VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pBindings = bindings,
+        .bindingCount = ARRAY_LEN(bindings),
+    };
+
+    VkDescriptorSetLayout layout;
+    VkResult result =
+        vkCreateDescriptorSetLayout(device, &set_layout_info, allocation_callbacks, &layout);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateDescriptorSetLayout() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return layout;
+}
+
+static VkPipelineLayout create_pipeline_layout(VkDevice device,
+                                               const VkAllocationCallbacks *allocation_callbacks,
+                                               VkDescriptorSetLayout set_layout) {
+    const VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pSetLayouts = &set_layout,
+        .setLayoutCount = 1,
+    };
+
+    VkPipelineLayout layout;
+    VkResult result =
+        vkCreatePipelineLayout(device, &pipeline_layout_info, allocation_callbacks, &layout);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreatePipelineLayout() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return layout;
+}
+
+/* Specialisation constants 0 to 4 of pack.comp. */
+typedef struct Pack_Constants {
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_pitch;
+    uint32_t scale;
+} Pack_Constants;
+
+static const Specialization_Constant pack_constants[] = {
+    {0, offsetof(Pack_Constants, format)},
+    {1, offsetof(Pack_Constants, width)},
+    {2, offsetof(Pack_Constants, height)},
+    {3, offsetof(Pack_Constants, row_pitch)},
+    {4, offsetof(Pack_Constants, scale)},
+};
+
+static VkPipeline create_pipeline(VkDevice device,
+                                  const VkAllocationCallbacks *allocation_callbacks,
+                                  VkPipelineLayout layout, VkShaderModule shader,
+                                  VkPipelineCache pipeline_cache,
+                                  const Readback_Layout *readback_layout, uint32_t scale) {
+    const Pack_Constants constants = {
+        .format = (uint32_t)readback_layout->format,
+        .width = readback_layout->width,
+        .height = readback_layout->height,
+        .row_pitch = readback_layout->row_pitch,
+        .scale = scale,
+    };
+
+    Specialization specialization;
+    init_specialization(pack_constants, ARRAY_LEN(pack_constants), &constants, sizeof(constants),
+                        &specialization);
+
+    const VkComputePipelineCreateInfo compute_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .layout = layout,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .module = shader,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pName = "main",
+                .pSpecializationInfo = &specialization.info,
+            },
+    };
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(device, pipeline_cache, 1, &compute_pipeline_info,
+                                               allocation_callbacks, &pipeline);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateComputePipelines() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return pipeline;
+}
+
+bool create_pack_pipeline(const Device *device, VkShaderModule shader,
+                          VkPipelineCache pipeline_cache, const Readback_Layout *layout,
+                          uint32_t scale, Pack_Pipeline *pipeline) {
+    assert(device);
+    assert(shader);
+    assert(layout);
+    assert(scale > 0);
+    assert(pipeline);
+
+    *pipeline = (Pack_Pipeline){
+        .layout = *layout,
+        .scale = scale,
+    };
+
+    const VkAllocationCallbacks *allocation_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE);
+
+    pipeline->descriptor_set_layout =
+        create_descriptor_set_layout(device->device, allocation_callbacks);
+    if (!pipeline->descriptor_set_layout) {
+        fprintf(stderr, "create_descriptor_set_layout() failed\n");
+        return false;
+    }
+
+    pipeline->pipeline_layout = create_pipeline_layout(device->device, allocation_callbacks,
+                                                       pipeline->descriptor_set_layout);
+    if (!pipeline->pipeline_layout) {
+        fprintf(stderr, "create_pipeline_layout() failed\n");
+        return false;
+    }
+
+    pipeline->pipeline =
+        create_pipeline(device->device, allocation_callbacks, pipeline->pipeline_layout, shader,
+                        pipeline_cache, layout, scale);
+    if (!pipeline->pipeline) {
+        fprintf(stderr, "create_pipeline() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+void destroy_pack_pipeline(const Device *device, Pack_Pipeline *pipeline) {
+    const VkAllocationCallbacks *allocation_callbacks =
+        host_allocator_callbacks(device->host_allocator, HOST_ALLOCATION_PIPELINE);
+
+    vkDestroyPipeline(device->device, pipeline->pipeline, allocation_callbacks);
+    vkDestroyPipelineLayout(device->device, pipeline->pipeline_layout, allocation_callbacks);
+    vkDestroyDescriptorSetLayout(device->device, pipeline->descriptor_set_layout,
+                                 allocation_callbacks);
+}
+
+void record_pack(const Device *device, const Pack_Pipeline *pipeline,
+                 VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set) {
+    const Device_Functions *fn = &device->fn;
+
+    fn->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+    fn->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipeline->pipeline_layout, 0, 1, &descriptor_set, 0, NULL);
+
+    /* One invocation per 32-bit word of a row, one row of workgroups per image row. */
+    uint32_t row_words = pipeline->layout.row_pitch / 4;
+    fn->vkCmdDispatch(command_buffer, (row_words + PACK_WORKGROUP_SIZE - 1) / PACK_WORKGROUP_SIZE,
+                      pipeline->layout.height, 1);
+}
@@ -0,0 +1,85 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+/* Pixel layouts the accumulated samples can be packed into for the host. Must match the FORMAT_*
+ * constants in pack.comp.
+ */
+typedef enum Readback_Format {
+    /* 8-bit unsigned normalised channels, alpha always 1. */
+    READBACK_FORMAT_RGBA8,
+    READBACK_FORMAT_RGB8,
+
+    /* Linear radiance, alpha always 1. */
+    READBACK_FORMAT_RGBA16F,
+    READBACK_FORMAT_RGBA32F,
+
+    /* The bit layout of VK_FORMAT_B10G11R11_UFLOAT_PACK32: red in the low 11 bits. */
+    READBACK_FORMAT_R11G11B10F,
+
+    READBACK_FORMAT_COUNT,
+} Readback_Format;
+
+/* How one frame is laid out in host memory. */
+typedef struct Readback_Layout {
+    Readback_Format format;
+    uint32_t width;
+    uint32_t height;
+
+    uint32_t pixel_size;
+
+    /* Bytes from the start of one row to the next. At least width * pixel_size, and a multiple
+     * of 4 because the pack kernel writes whole words; padding bytes are zero.
+     */
+    uint32_t row_pitch;
+
+    VkDeviceSize size;
+} Readback_Layout;
+
+/* Returns the layout of a `width` x `height` frame in `format`, with rows padded to a multiple of
+ * `row_alignment` bytes, which must be a power of two.
+ */
+Readback_Layout get_readback_layout(Readback_Format format, uint32_t width, uint32_t height,
+                                    uint32_t row_alignment);
+
+/* Lowercase name, as accepted by --output-format. */
+const char *readback_format_name(Readback_Format format);
+
+/* Looks up a format by its readback_format_name(). Returns false if there is none. */
+bool find_readback_format(const char *name, Readback_Format *out_format);
+
+/* Packs the accumulation image into a storage buffer in one Readback_Layout, so the host gets
+ * exactly the bytes its encoder wants and the copy moves nothing else. With a `scale` above 1
+ * each packed pixel averages a `scale` x `scale` block, so the layout is that much smaller than
+ * the image. The layout and scale are baked in through specialisation constants.
+ */
+typedef struct Pack_Pipeline {
+    Readback_Layout layout;
+    uint32_t scale;
+
+    /* Binding 0: the accumulation image. Binding 1: the packed storage buffer. */
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+} Pack_Pipeline;
+
+/* `pipeline_cache` may be VK_NULL_HANDLE. `layout` must cover the image divided by `scale`,
+ * rounded up.
+ */
+bool create_pack_pipeline(const Device *device, VkShaderModule shader,
+                          VkPipelineCache pipeline_cache, const Readback_Layout *layout,
+                          uint32_t scale, Pack_Pipeline *pipeline);
+void destroy_pack_pipeline(const Device *device, Pack_Pipeline *pipeline);
+
+/* Records the pack of the accumulation image into the buffer bound by `descriptor_set`. The
+ * caller orders it after the passes and before whatever reads the buffer.
+ */
+void record_pack(const Device *device, const Pack_Pipeline *pipeline,
+                 VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set);
+
+#endif /* READBACK_H */
@@ -0,0 +1,1451 @@
+#include "renderer.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#include "bindless.h"
+#include "camera.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "pipeline.h"
+#include "pass_params.h"
+#include "profile.h"
+#include "readback.h"
+#include "timer.h"
+#include "utils.h"
+
+/* Must match the format qualifier of u_accumulation in pathtracer.comp. */
+#define ACCUMULATION_FORMAT VK_FORMAT_R32G32B32A32_SFLOAT
+
+/* One slot of the parameter buffer. Pass_Params change from slice to slice, and the pass command
+ * buffers are recorded once, so the kernel reads them from here rather than from push constants
+ * unless passes are recorded per slice. The dispatch size varies with the slice height, so it is
+ * read by vkCmdDispatchIndirect() from the same slot instead of being recorded.
+ */
+typedef struct Slice_Params {
+    Pass_Params pass;
+    VkDispatchIndirectCommand dispatch;
+} Slice_Params;
+
+/* Host reads from uncached memory, such as the BAR of a discrete GPU, cost more than the copy
+ * they would replace, so zero-copy packed buffers only use cached memory.
+ */
+#define ZERO_COPY_MEMORY_FLAGS                                                                     \
+    (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |                   \
+     VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+
+/* Slice height before any slice has been measured, as a fraction of the image. */
+#define INITIAL_SLICES_PER_PASS 8
+
+/* Each measurement may at most double the slice height, so one fast outlier cannot jump straight
+ * to a slice that takes far longer than the target.
+ */
+#define MAX_SLICE_GROWTH 2.0
+
+/* The path tracing set, one pack set per frame in flight and the preview pack set. Each binds the
+ * accumulation image, and the pack sets a packed buffer as well.
+ */
+static VkDescriptorPool create_descriptor_pool(VkDevice device,
+                                               const VkAllocationCallbacks *allocation_callbacks) {
+    const VkDescriptorPoolSize pool_sizes[] = {
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 2 + RENDERER_FRAMES_IN_FLIGHT,
+        },
+
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1 + RENDERER_FRAMES_IN_FLIGHT,
+        },
+
+        (VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+        },
+    };
+
+    const VkDescriptorPoolCreateInfo descriptor_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 2 + RENDERER_FRAMES_IN_FLIGHT,
+        .pPoolSizes = pool_sizes,
+        .poolSizeCount = ARRAY_LEN(pool_sizes),
+    };
+
+    VkDescriptorPool descriptor_pool;
+    VkResult result = vkCreateDescriptorPool(device, &descriptor_pool_info, allocation_callbacks,
+                                             &descriptor_pool);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateDescriptorPool() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return descriptor_pool;
+}
+
+static VkDescriptorSet create_descriptor_set(VkDevice device, VkDescriptorPool descriptor_pool,
+                                             VkDescriptorSetLayout layout) {
+    const VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+
+    VkDescriptorSet descriptor_set;
+    VkResult result = vkAllocateDescriptorSets(device, &alloc_info, &descriptor_set);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkAllocateDescriptorSets failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return descriptor_set;
+}
+
+static VkImage create_compute_image(VmaAllocator allocator, uint32_t width, uint32_t height,
+                                    VkFormat format, VkImageUsageFlags usage,
+                                    VmaAllocation *allocation) {
+    const VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent =
+            (VkExtent3D){
+                .width = width,
+                .height = height,
+                .depth = 1,
+            },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    };
+
+    VkImage image;
+    VkResult result = vmaCreateImage(allocator, &image_info, &alloc_info, &image, allocation, NULL);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateImage() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return image;
+}
+
+static VkImageView create_compute_image_view(VkDevice device,
+                                             const VkAllocationCallbacks *allocation_callbacks,
+                                             VkImage image, VkFormat format) {
+    const VkImageViewCreateInfo image_view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .subresourceRange =
+            (VkImageSubresourceRange){
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+
+    VkImageView view;
+    VkResult result = vkCreateImageView(device, &image_view_info, allocation_callbacks, &view);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateImageView() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return view;
+}
+
+static VkCommandPool create_command_pool(VkDevice device,
+                                         const VkAllocationCallbacks *allocation_callbacks,
+                                         uint32_t queue_family_index) {
+    const VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queue_family_index,
+    };
+
+    VkCommandPool command_pool;
+    VkResult result =
+        vkCreateCommandPool(device, &command_pool_info, allocation_callbacks, &command_pool);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateCommandPool() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return command_pool;
+}
+
+static VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool command_pool) {
+    const VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer command_buffer;
+    VkResult result = vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkAllocateCommandBuffers() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return command_buffer;
+}
+
+static VkBuffer create_device_buffer(VmaAllocator allocator, VkDeviceSize size,
+                                     VkBufferUsageFlags usage, VmaAllocation *allocation) {
+    const VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    };
+
+    VkBuffer buffer;
+    VkResult result =
+        vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer, allocation, NULL);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateBuffer() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return buffer;
+}
+
+/* `host_access` is one of the VMA_ALLOCATION_CREATE_HOST_ACCESS_* flags. `required_flags` may
+ * restrict the memory further, for example to device-local memory.
+ */
+static VkBuffer create_host_buffer(VmaAllocator allocator, VkDeviceSize size,
+                                   VkBufferUsageFlags usage, VmaAllocationCreateFlags host_access,
+                                   VkMemoryPropertyFlags required_flags, VmaAllocation *allocation,
+                                   VmaAllocationInfo *allocation_info) {
+    const VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .flags = host_access | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .requiredFlags = required_flags,
+    };
+
+    VkBuffer buffer;
+    VkResult result =
+        vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer, allocation, allocation_info);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaCreateBuffer() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return buffer;
+}
+
+/* Two timestamps per submit slot, around its dispatch. */
+static VkQueryPool create_timestamp_pool(VkDevice device,
+                                         const VkAllocationCallbacks *allocation_callbacks) {
+    const VkQueryPoolCreateInfo query_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * RENDERER_MAX_SUBMITS_IN_FLIGHT,
+    };
+
+    VkQueryPool query_pool;
+    VkResult result =
+        vkCreateQueryPool(device, &query_pool_info, allocation_callbacks, &query_pool);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateQueryPool() failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return query_pool;
+}
+
+static bool create_frame(const Renderer *renderer, VkCommandPool readback_command_pool,
+                         Renderer_Frame *frame) {
+    VkDevice device = renderer->device->device;
+    const Renderer_Info *info = &renderer->info;
+
+    frame->start_command_buffer = create_command_buffer(device, renderer->compute_command_pool);
+    frame->end_command_buffer = create_command_buffer(device, renderer->compute_command_pool);
+    if (!frame->start_command_buffer || !frame->end_command_buffer) {
+        fprintf(stderr, "create_command_buffer() failed\n");
+        return false;
+    }
+
+    /* Zero-copy frames are read straight from the packed buffer. */
+    if (info->zero_copy) {
+        frame->packed_buffer = create_host_buffer(
+            renderer->allocator, info->readback.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, ZERO_COPY_MEMORY_FLAGS,
+            &frame->packed_allocation, &frame->packed_allocation_info);
+        if (!frame->packed_buffer) {
+            fprintf(stderr, "create_host_buffer() failed\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    frame->packed_buffer = create_device_buffer(
+        renderer->allocator, info->readback.size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        &frame->packed_allocation);
+    if (!frame->packed_buffer) {
+        fprintf(stderr, "create_device_buffer() failed\n");
+        return false;
+    }
+
+    /* Sized to the packed frame alone. Host reads go through cached memory, which RANDOM asks
+     * for and SEQUENTIAL_WRITE would not.
+     */
+    frame->readback_buffer = create_host_buffer(
+        renderer->allocator, info->readback.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, 0, &frame->readback_allocation,
+        &frame->readback_allocation_info);
+    if (!frame->readback_buffer) {
+        fprintf(stderr, "create_host_buffer() failed\n");
+        return false;
+    }
+
+    frame->readback_command_buffer = create_command_buffer(device, readback_command_pool);
+    if (!frame->readback_command_buffer) {
+        fprintf(stderr, "create_command_buffer() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool renderer_supports_zero_copy(const Device *device) {
+    assert(device);
+
+    const VkPhysicalDeviceMemoryProperties *memory = &device->info.memory_properties;
+    for (uint32_t i = 0; i < memory->memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memory->memoryTypes[i].propertyFlags;
+        if ((flags & ZERO_COPY_MEMORY_FLAGS) == ZERO_COPY_MEMORY_FLAGS) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool create_renderer(const Device *device, VmaAllocator allocator, const Renderer_Info *info,
+                     Profile *profile, Renderer *renderer) {
+    assert(device);
+    assert(allocator);
+    assert(info);
+    assert(info->passes > 0);
+    assert(info->output_width >= info->width && info->output_height >= info->height);
+    assert(info->readback.width == info->width && info->readback.height == info->height);
+    assert(!info->preview_scale ||
+           (info->preview.width == (info->width + info->preview_scale - 1) / info->preview_scale &&
+            info->preview.height ==
+                (info->height + info->preview_scale - 1) / info->preview_scale));
+    assert(profile);
+    assert(renderer);
+
+    *renderer = (Renderer){
+        .device = device,
+        .allocator = allocator,
+        .info = *info,
+    };
+
+    VkDevice vk_device = device->device;
+    Host_Allocator *host_allocator = device->host_allocator;
+
+    profile_begin(profile, "descriptor_pool");
+    renderer->descriptor_pool = create_descriptor_pool(
+        vk_device, host_allocator_callbacks(host_allocator, HOST_ALLOCATION_DESCRIPTOR));
+    if (!renderer->descriptor_pool) {
+        fprintf(stderr, "create_descriptor_pool() failed\n");
+        return false;
+    }
+    profile_end(profile);
+
+    profile_begin(profile, "image");
+    renderer->accumulation_image = create_compute_image(
+        allocator, info->width, info->height, ACCUMULATION_FORMAT,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        &renderer->accumulation_allocation);
+    if (!renderer->accumulation_image) {
+        fprintf(stderr, "create_compute_image() failed\n");
+        return false;
+    }
+
+    renderer->accumulation_view = create_compute_image_view(
+        vk_device, host_allocator_callbacks(host_allocator, HOST_ALLOCATION_IMAGE),
+        renderer->accumulation_image, ACCUMULATION_FORMAT);
+    if (!renderer->accumulation_view) {
+        fprintf(stderr, "create_compute_image_view() failed\n");
+        return false;
+    }
+    profile_end(profile);
+
+    profile_begin(profile, "host_buffer");
+    /* One Slice_Params slot per submission in flight, bound with a dynamic offset. */
+    VkDeviceSize offset_alignment = device->info.properties.limits.minUniformBufferOffsetAlignment;
+    renderer->params_stride =
+        (sizeof(Slice_Params) + offset_alignment - 1) / offset_alignment * offset_alignment;
+
+    renderer->params_buffer = create_host_buffer(
+        allocator, renderer->params_stride * RENDERER_MAX_SUBMITS_IN_FLIGHT,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, 0, &renderer->params_allocation,
+        &renderer->params_allocation_info);
+    if (!renderer->params_buffer) {
+        fprintf(stderr, "create_host_buffer() failed\n");
+        return false;
+    }
+
+    /* Previews are small and read once, so the pack writes them straight into host memory. */
+    if (info->preview_scale) {
+        renderer->preview_buffer = create_host_buffer(
+            allocator, info->preview.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, 0, &renderer->preview_allocation,
+            &renderer->preview_allocation_info);
+        if (!renderer->preview_buffer) {
+            fprintf(stderr, "create_host_buffer() failed\n");
+            return false;
+        }
+    }
+    profile_end(profile);
+
+    profile_begin(profile, "command_pool");
+    const VkAllocationCallbacks *command_callbacks =
+        host_allocator_callbacks(host_allocator, HOST_ALLOCATION_COMMAND);
+
+    renderer->compute_command_pool =
+        create_command_pool(vk_device, command_callbacks, device->info.compute_family_index);
+    if (!renderer->compute_command_pool) {
+        fprintf(stderr, "create_command_pool() failed\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < RENDERER_MAX_SUBMITS_IN_FLIGHT; i++) {
+        renderer->submits[i].command_buffer =
+            create_command_buffer(vk_device, renderer->compute_command_pool);
+        if (!renderer->submits[i].command_buffer) {
+            fprintf(stderr, "create_command_buffer() failed\n");
+            return false;
+        }
+    }
+
+    if (info->preview_scale) {
+        renderer->preview_command_buffer =
+            create_command_buffer(vk_device, renderer->compute_command_pool);
+        if (!renderer->preview_command_buffer) {
+            fprintf(stderr, "create_command_buffer() failed\n");
+            return false;
+        }
+    }
+
+    VkCommandPool readback_command_pool = renderer->compute_command_pool;
+    if (device->async_transfer) {
+        renderer->transfer_command_pool =
+            create_command_pool(vk_device, command_callbacks, device->info.transfer_family_index);
+        if (!renderer->transfer_command_pool) {
+            fprintf(stderr, "create_command_pool() failed\n");
+            return false;
+        }
+
+        readback_command_pool = renderer->transfer_command_pool;
+    }
+
+    /* Without timestamps there is nothing to size slices from, so passes stay whole. */
+    renderer->slice_height = info->height;
+    if (info->slice_ms > 0.0 && device->info.compute_timestamp_valid_bits > 0) {
+        renderer->timestamp_pool = create_timestamp_pool(vk_device, command_callbacks);
+        if (!renderer->timestamp_pool) {
+            fprintf(stderr, "create_timestamp_pool() failed\n");
+            return false;
+        }
+
+        uint32_t align = info->workgroup_sizes.y;
+        uint32_t initial_height =
+            (info->height / INITIAL_SLICES_PER_PASS + align - 1) / align * align;
+        renderer->slice_height = initial_height > align ? initial_height : align;
+    }
+    profile_end(profile);
+
+    profile_begin(profile, "job_graph");
+    if (!create_job_graph(device, &renderer->jobs)) {
+        fprintf(stderr, "create_job_graph() failed\n");
+        return false;
+    }
+    profile_end(profile);
+
+    profile_begin(profile, "frame_resources");
+    for (uint32_t i = 0; i < RENDERER_FRAMES_IN_FLIGHT; i++) {
+        if (!create_frame(renderer, readback_command_pool, &renderer->frames[i])) {
+            fprintf(stderr, "create_frame() failed\n");
+            return false;
+        }
+    }
+    profile_end(profile);
+    return true;
+}
+
+/* Allocates a set for `pack_pipeline` that packs the accumulation image into `buffer`. */
+static VkDescriptorSet create_pack_descriptor_set(const Renderer *renderer,
+                                                  const Pack_Pipeline *pack_pipeline,
+                                                  VkBuffer buffer) {
+    VkDevice vk_device = renderer->device->device;
+
+    VkDescriptorSet descriptor_set = create_descriptor_set(vk_device, renderer->descriptor_pool,
+                                                           pack_pipeline->descriptor_set_layout);
+    if (!descriptor_set) {
+        fprintf(stderr, "create_descriptor_set() failed\n");
+        return VK_NULL_HANDLE;
+    }
+
+    const VkWriteDescriptorSet write_descriptor_sets[] = {
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo =
+                &(VkDescriptorImageInfo){
+                    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    .imageView = renderer->accumulation_view,
+                },
+        },
+
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptor_set,
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo =
+                &(VkDescriptorBufferInfo){
+                    .buffer = buffer,
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE,
+                },
+        },
+    };
+
+    renderer->device->fn.vkUpdateDescriptorSets(vk_device, ARRAY_LEN(write_descriptor_sets),
+                                                write_descriptor_sets, 0, NULL);
+    return descriptor_set;
+}
+
+bool bind_renderer_pipeline(Renderer *renderer, const Pathtracing_Pipeline *pipeline,
+                            const Pack_Pipeline *pack_pipeline,
+                            const Pack_Pipeline *preview_pipeline) {
+    assert(renderer);
+    assert(pipeline);
+    assert(pack_pipeline);
+    assert(!renderer->pipeline);
+    assert(pack_pipeline->scale == 1 &&
+           pack_pipeline->layout.format == renderer->info.readback.format &&
+           pack_pipeline->layout.row_pitch == renderer->info.readback.row_pitch &&
+           pack_pipeline->layout.height == renderer->info.readback.height);
+    assert(!renderer->info.preview_scale ||
+           (preview_pipeline && preview_pipeline->scale == renderer->info.preview_scale &&
+            preview_pipeline->layout.row_pitch == renderer->info.preview.row_pitch &&
+            preview_pipeline->layout.height == renderer->info.preview.height));
+
+    /* Push constants only change when the pass is recorded again. */
+    if (pipeline->constants.push_params != (uint32_t)renderer->info.rerecord_passes) {
+        fprintf(stderr, "Pipelines read Pass_Params from push constants exactly when passes are "
+                        "re-recorded\n");
+        return false;
+    }
+
+    const Device_Functions *fn = &renderer->device->fn;
+    VkDevice vk_device = renderer->device->device;
+
+    renderer->descriptor_set = create_descriptor_set(vk_device, renderer->descriptor_pool,
+                                                     pipeline->descriptor_set_layout);
+    if (!renderer->descriptor_set) {
+        fprintf(stderr, "create_descriptor_set() failed\n");
+        return false;
+    }
+
+    const VkWriteDescriptorSet write_descriptor_sets[] = {
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = renderer->descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo =
+                &(VkDescriptorImageInfo){
+                    .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    .imageView = renderer->accumulation_view,
+                },
+        },
+
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = renderer->descriptor_set,
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .pBufferInfo =
+                &(VkDescriptorBufferInfo){
+                    .buffer = renderer->params_buffer,
+                    .offset = 0,
+                    .range = sizeof(Pass_Params),
+                },
+        },
+    };
+
+    fn->vkUpdateDescriptorSets(vk_device, ARRAY_LEN(write_descriptor_sets), write_descriptor_sets,
+                               0, NULL);
+
+    if (!create_bindless_set(renderer->device, renderer->allocator, &pipeline->scene_layout,
+                             &renderer->scene)) {
+        fprintf(stderr, "create_bindless_set() failed\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < RENDERER_FRAMES_IN_FLIGHT; i++) {
+        Renderer_Frame *frame = &renderer->frames[i];
+        frame->pack_descriptor_set =
+            create_pack_descriptor_set(renderer, pack_pipeline, frame->packed_buffer);
+        if (!frame->pack_descriptor_set) {
+            fprintf(stderr, "create_pack_descriptor_set() failed\n");
+            return false;
+        }
+    }
+
+    if (renderer->info.preview_scale) {
+        renderer->preview_descriptor_set =
+            create_pack_descriptor_set(renderer, preview_pipeline, renderer->preview_buffer);
+        if (!renderer->preview_descriptor_set) {
+            fprintf(stderr, "create_pack_descriptor_set() failed\n");
+            return false;
+        }
+    }
+
+    renderer->pipeline = pipeline;
+    renderer->kernel = get_kernel(pipeline, KERNEL_PATHTRACE);
+    renderer->pack_pipeline = pack_pipeline;
+    renderer->preview_pipeline = preview_pipeline;
+    return true;
+}
+
+void set_renderer_kernel(Renderer *renderer, VkPipeline kernel) {
+    assert(renderer);
+    assert(renderer->pipeline);
+    assert(kernel);
+    assert(!renderer->recorded);
+
+    renderer->kernel = kernel;
+}
+
+void destroy_renderer(Renderer *renderer) {
+    VkDevice device = renderer->device->device;
+    Host_Allocator *host_allocator = renderer->device->host_allocator;
+
+    for (uint32_t i = 0; i < RENDERER_FRAMES_IN_FLIGHT; i++) {
+        const Renderer_Frame *frame = &renderer->frames[i];
+        vmaDestroyBuffer(renderer->allocator, frame->readback_buffer, frame->readback_allocation);
+        vmaDestroyBuffer(renderer->allocator, frame->packed_buffer, frame->packed_allocation);
+    }
+
+    destroy_job_graph(&renderer->jobs);
+    destroy_bindless_set(renderer->device, renderer->allocator, &renderer->scene);
+    vkDestroyQueryPool(device, renderer->timestamp_pool,
+                       host_allocator_callbacks(host_allocator, HOST_ALLOCATION_COMMAND));
+    vkDestroyCommandPool(device, renderer->transfer_command_pool,
+                         host_allocator_callbacks(host_allocator, HOST_ALLOCATION_COMMAND));
+    vkDestroyCommandPool(device, renderer->compute_command_pool,
+                         host_allocator_callbacks(host_allocator, HOST_ALLOCATION_COMMAND));
+    vkDestroyImageView(device, renderer->accumulation_view,
+                       host_allocator_callbacks(host_allocator, HOST_ALLOCATION_IMAGE));
+    vmaDestroyBuffer(renderer->allocator, renderer->preview_buffer, renderer->preview_allocation);
+    vmaDestroyBuffer(renderer->allocator, renderer->params_buffer, renderer->params_allocation);
+    vmaDestroyImage(renderer->allocator, renderer->accumulation_image,
+                    renderer->accumulation_allocation);
+    vkDestroyDescriptorPool(device, renderer->descriptor_pool,
+                            host_allocator_callbacks(host_allocator, HOST_ALLOCATION_DESCRIPTOR));
+}
+
+static bool begin_command_buffer(const Device_Functions *fn, VkCommandBuffer command_buffer,
+                                 VkCommandBufferUsageFlags flags) {
+    const VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = flags,
+    };
+
+    VkResult result = fn->vkBeginCommandBuffer(command_buffer, &begin_info);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkBeginCommandBuffer() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    return true;
+}
+
+static const VkImageSubresourceRange color_subresource_range = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+/* Discards and zeroes the accumulation target before the first pass of a frame. The source scope
+ * covers the previous frame's passes and pack, which may still be running on the same queue.
+ */
+static void record_frame_start(const Renderer *renderer, VkCommandBuffer command_buffer) {
+    const Device_Functions *fn = &renderer->device->fn;
+
+    record_bindless_set_start(renderer->device, &renderer->scene, command_buffer);
+
+    const VkImageMemoryBarrier to_transfer_dst = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = renderer->accumulation_image,
+        .subresourceRange = color_subresource_range,
+    };
+
+    fn->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                             &to_transfer_dst);
+
+    const VkClearColorValue zero = {
+        .float32 = {0.0f, 0.0f, 0.0f, 0.0f},
+    };
+
+    fn->vkCmdClearColorImage(command_buffer, renderer->accumulation_image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1,
+                             &color_subresource_range);
+
+    const VkImageMemoryBarrier cleared_to_general = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = renderer->accumulation_image,
+        .subresourceRange = color_subresource_range,
+    };
+
+    fn->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1,
+                             &cleared_to_general);
+}
+
+/* Orders a pass, or the pack, after the previous pass, which wrote the accumulation image.
+ * Submission order on one queue makes a barrier in a later command buffer sufficient.
+ */
+static void record_pass_dependency(const Renderer *renderer, VkCommandBuffer command_buffer) {
+    const VkMemoryBarrier previous_pass = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+
+    renderer->device->fn.vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &previous_pass, 0, NULL, 0, NULL);
+}
+
+/* Records a slice that reads its dispatch size, and unless the pipeline takes them as push
+ * constants its Pass_Params, from `slot` of the parameter buffer. `push_params` are pushed either
+ * way, since every push constant in the layout must be defined. With a timestamp pool, the slot's
+ * two queries bracket the dispatch: both are written once earlier compute work has finished, so
+ * their difference is the slice's own GPU time.
+ */
+static void record_dispatch(const Renderer *renderer, VkCommandBuffer command_buffer,
+                            uint32_t slot, const Pass_Params *push_params) {
+    const Device_Functions *fn = &renderer->device->fn;
+
+    VkDeviceSize slot_offset = renderer->params_stride * slot;
+    uint32_t params_offset = (uint32_t)slot_offset;
+
+    fn->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->kernel);
+    const VkDescriptorSet descriptor_sets[] = {renderer->descriptor_set, renderer->scene.set};
+    fn->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                renderer->pipeline->layout, 0, ARRAY_LEN(descriptor_sets),
+                                descriptor_sets, 1, &params_offset);
+    fn->vkCmdPushConstants(command_buffer, renderer->pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(*push_params), push_params);
+
+    if (renderer->timestamp_pool) {
+        fn->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                renderer->timestamp_pool, 2 * slot);
+    }
+
+    fn->vkCmdDispatchIndirect(command_buffer, renderer->params_buffer,
+                              slot_offset + offsetof(Slice_Params, dispatch));
+
+    if (renderer->timestamp_pool) {
+        fn->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                renderer->timestamp_pool, 2 * slot + 1);
+    }
+}
+
+/* Makes the pack's writes to the packed buffer visible to the device -> host copy. With distinct
+ * families, `release` records the compute side of the ownership transfer and the matching
+ * acquire is recorded on the transfer queue with `release` false.
+ */
+static void record_to_transfer_src(const Renderer *renderer, VkCommandBuffer command_buffer,
+                                   const Renderer_Frame *frame, bool release) {
+    const Device *device = renderer->device;
+    bool ownership_transfer = device->async_transfer;
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = frame->packed_buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    if (ownership_transfer) {
+        barrier.srcQueueFamilyIndex = device->info.compute_family_index;
+        barrier.dstQueueFamilyIndex = device->info.transfer_family_index;
+
+        /* The release only makes the writes available and the acquire only makes them visible;
+         * the semaphore between the two submissions provides the execution dependency.
+         */
+        if (release) {
+            barrier.dstAccessMask = 0;
+            dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        } else {
+            barrier.srcAccessMask = 0;
+            src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+    }
+
+    device->fn.vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 1, &barrier,
+                                    0, NULL);
+}
+
+/* Makes a host-visible buffer written by the pack kernel, the zero-copy packed buffer or the
+ * preview, visible to host reads once the submission has been waited on.
+ */
+static void record_packed_to_host(const Renderer *renderer, VkCommandBuffer command_buffer,
+                                  VkBuffer buffer) {
+    const VkBufferMemoryBarrier to_host = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    renderer->device->fn.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                              VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &to_host,
+                                              0, NULL);
+}
+
+/* Copies the packed frame as is: it is already in the layout the host wants. */
+static void record_readback(const Renderer *renderer, VkCommandBuffer command_buffer,
+                            const Renderer_Frame *frame) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkBuffer readback_buffer = frame->readback_buffer;
+
+    const VkBufferCopy copy_region = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = renderer->info.readback.size,
+    };
+
+    fn->vkCmdCopyBuffer(command_buffer, frame->packed_buffer, readback_buffer, 1, &copy_region);
+
+    /* Make the copy visible to host reads once the fence has been waited on. */
+    const VkBufferMemoryBarrier to_host = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readback_buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+
+    fn->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &to_host, 0, NULL);
+}
+
+static bool end_command_buffer(const Device_Functions *fn, VkCommandBuffer command_buffer) {
+    VkResult result = fn->vkEndCommandBuffer(command_buffer);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkEndCommandBuffer() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    return true;
+}
+
+/* The command buffers submitted for a frame: its frame start (first slice only), each slice of a
+ * pass in the submit's slot and its frame end (last slice only) on the compute queue, then its
+ * readback.
+ * Unless `info.rerecord_passes` is set they are recorded once by the first begin_frame() and
+ * replayed afterwards, since nothing recorded in them changes between passes or frames.
+ */
+static bool record_frame_start_commands(const Renderer *renderer, const Renderer_Frame *frame,
+                                        VkCommandBufferUsageFlags flags) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkCommandBuffer command_buffer = frame->start_command_buffer;
+
+    if (!begin_command_buffer(fn, command_buffer, flags)) {
+        return false;
+    }
+
+    record_frame_start(renderer, command_buffer);
+    return end_command_buffer(fn, command_buffer);
+}
+
+static bool record_pass_commands(const Renderer *renderer, uint32_t slot,
+                                 const Pass_Params *push_params, VkCommandBufferUsageFlags flags) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkCommandBuffer command_buffer = renderer->submits[slot].command_buffer;
+
+    if (!begin_command_buffer(fn, command_buffer, flags)) {
+        return false;
+    }
+
+    if (renderer->timestamp_pool) {
+        fn->vkCmdResetQueryPool(command_buffer, renderer->timestamp_pool, 2 * slot, 2);
+    }
+
+    /* Redundant for the first slice, but keeps one recording valid for every slice. */
+    record_pass_dependency(renderer, command_buffer);
+    record_dispatch(renderer, command_buffer, slot, push_params);
+    return end_command_buffer(fn, command_buffer);
+}
+
+static bool record_frame_end_commands(const Renderer *renderer, const Renderer_Frame *frame,
+                                      VkCommandBufferUsageFlags flags) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkCommandBuffer command_buffer = frame->end_command_buffer;
+
+    if (!begin_command_buffer(fn, command_buffer, flags)) {
+        return false;
+    }
+
+    record_pass_dependency(renderer, command_buffer);
+    record_pack(renderer->device, renderer->pack_pipeline, command_buffer,
+                frame->pack_descriptor_set);
+
+    if (renderer->info.zero_copy) {
+        record_packed_to_host(renderer, command_buffer, frame->packed_buffer);
+    } else {
+        record_to_transfer_src(renderer, command_buffer, frame, true);
+    }
+
+    return end_command_buffer(fn, command_buffer);
+}
+
+static bool record_readback_commands(const Renderer *renderer, const Renderer_Frame *frame,
+                                     VkCommandBufferUsageFlags flags) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkCommandBuffer command_buffer = frame->readback_command_buffer;
+
+    if (!begin_command_buffer(fn, command_buffer, flags)) {
+        return false;
+    }
+
+    /* The matching acquire for the release in the frame end. */
+    if (renderer->device->async_transfer) {
+        record_to_transfer_src(renderer, command_buffer, frame, false);
+    }
+
+    record_readback(renderer, command_buffer, frame);
+    return end_command_buffer(fn, command_buffer);
+}
+
+/* Packs the accumulation image as the passes submitted before it left it, downsampled into the
+ * preview buffer. The next pass orders itself after the pack through its own barrier.
+ */
+static bool record_preview_commands(const Renderer *renderer, VkCommandBufferUsageFlags flags) {
+    const Device_Functions *fn = &renderer->device->fn;
+    VkCommandBuffer command_buffer = renderer->preview_command_buffer;
+
+    if (!begin_command_buffer(fn, command_buffer, flags)) {
+        return false;
+    }
+
+    record_pass_dependency(renderer, command_buffer);
+    record_pack(renderer->device, renderer->preview_pipeline, command_buffer,
+                renderer->preview_descriptor_set);
+    record_packed_to_host(renderer, command_buffer, renderer->preview_buffer);
+    return end_command_buffer(fn, command_buffer);
+}
+
+static bool record_command_buffers(const Renderer *renderer) {
+    /* Replayed passes read their Pass_Params from the parameter buffer. */
+    const Pass_Params unused_push_params = {0};
+
+    for (uint32_t slot = 0; slot < RENDERER_MAX_SUBMITS_IN_FLIGHT; slot++) {
+        if (!record_pass_commands(renderer, slot, &unused_push_params, 0)) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < RENDERER_FRAMES_IN_FLIGHT; i++) {
+        const Renderer_Frame *frame = &renderer->frames[i];
+        if (!record_frame_start_commands(renderer, frame, 0) ||
+            !record_frame_end_commands(renderer, frame, 0) ||
+            (!renderer->info.zero_copy && !record_readback_commands(renderer, frame, 0))) {
+            return false;
+        }
+    }
+
+    if (renderer->info.preview_scale && !record_preview_commands(renderer, 0)) {
+        return false;
+    }
+
+    return true;
+}
+
+static Pass_Params get_pass_params(const Renderer *renderer, uint32_t pass, uint32_t slice_y) {
+    const Renderer_Info *info = &renderer->info;
+    const Renderer_Frame *frame = renderer->frame;
+    uint32_t samples_per_pass = renderer->pipeline->constants.samples_per_dispatch;
+
+    /* Tiles at the right and bottom edges reach past the output. */
+    uint32_t tile_width = info->output_width - frame->tile_x;
+    uint32_t tile_height = info->output_height - frame->tile_y;
+
+    Pass_Params params = {
+        .frame_index = frame->frame_index,
+        .seed = info->seed,
+        .sample_offset = (frame->frame_index * info->passes + pass) * samples_per_pass,
+        .slice_y = slice_y,
+        .tile_x = frame->tile_x,
+        .tile_y = frame->tile_y,
+        .tile_width = tile_width < info->width ? tile_width : info->width,
+        .tile_height = tile_height < info->height ? tile_height : info->height,
+        .output_width = info->output_width,
+        .output_height = info->output_height,
+    };
+
+    float aspect = (float)info->output_width / (float)info->output_height;
+    const Camera_Basis camera = get_camera_basis(&frame->camera, aspect);
+    memcpy(params.camera_origin, camera.origin, sizeof(params.camera_origin));
+    memcpy(params.camera_forward, camera.forward, sizeof(params.camera_forward));
+    memcpy(params.camera_right, camera.right, sizeof(params.camera_right));
+    memcpy(params.camera_up, camera.up, sizeof(params.camera_up));
+    return params;
+}
+
+static bool write_slice_params(const Renderer *renderer, uint32_t slot, const Pass_Params *pass,
+                               uint32_t slice_rows) {
+    const Renderer_Info *info = &renderer->info;
+
+    const Slice_Params params = {
+        .pass = *pass,
+        .dispatch =
+            {
+                .x = (info->width + info->workgroup_sizes.x - 1) / info->workgroup_sizes.x,
+                .y = (slice_rows + info->workgroup_sizes.y - 1) / info->workgroup_sizes.y,
+                .z = 1,
+            },
+    };
+
+    VkDeviceSize offset = renderer->params_stride * slot;
+    memcpy((uint8_t *)renderer->params_allocation_info.pMappedData + offset, &params,
+           sizeof(params));
+
+    /* A no-op on host-coherent memory. */
+    VkResult result = vmaFlushAllocation(renderer->allocator, renderer->params_allocation, offset,
+                                         sizeof(params));
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaFlushAllocation() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    return true;
+}
+
+/* Reads the GPU time of the slice last submitted in `slot` and resizes the next slices so they
+ * take about `info.slice_ms`, assuming time scales with the number of rows.
+ */
+static bool measure_slice(Renderer *renderer, uint32_t slot) {
+    const Device *device = renderer->device;
+    const Renderer_Info *info = &renderer->info;
+    Renderer_Submit *submit = &renderer->submits[slot];
+
+    /* The slot's submission has completed, so the results are available without waiting. */
+    uint64_t timestamps[2];
+    VkResult result = device->fn.vkGetQueryPoolResults(
+        device->device, renderer->timestamp_pool, 2 * slot, 2, sizeof(timestamps), timestamps,
+        sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkGetQueryPoolResults() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    submit->timed = false;
+
+    uint32_t valid_bits = device->info.compute_timestamp_valid_bits;
+    uint64_t mask = valid_bits >= 64 ? UINT64_MAX : (UINT64_C(1) << valid_bits) - 1;
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+    double gpu_ms = (double)ticks * device->info.properties.limits.timestampPeriod / 1e6;
+
+    renderer->timed_slices++;
+    renderer->timed_rows += submit->slice_rows;
+    renderer->slice_gpu_ms += gpu_ms;
+
+    double max_height = renderer->slice_height * MAX_SLICE_GROWTH;
+    double height = max_height;
+    if (gpu_ms > 0.0) {
+        height = info->slice_ms * submit->slice_rows / gpu_ms;
+    }
+
+    if (height > max_height) {
+        height = max_height;
+    }
+
+    /* Whole workgroups only, and at least one row of them. */
+    uint32_t align = info->workgroup_sizes.y;
+    uint32_t rows = height < info->height ? (uint32_t)height : info->height;
+    rows = rows / align * align;
+    renderer->slice_height = rows > align ? rows : align;
+    return true;
+}
+
+/* Queues the copy of the current frame into its readback buffer once the last pass has finished
+ * and the host has released the frame that used the buffer before.
+ */
+static bool submit_readback(Renderer *renderer, Job_Point last_pass_done) {
+    const Device *device = renderer->device;
+    Renderer_Frame *frame = renderer->frame;
+
+    if (renderer->info.rerecord_passes &&
+        !record_readback_commands(renderer, frame, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
+        return false;
+    }
+
+    Job_Desc desc = {
+        .lane = JOB_LANE_COMPUTE,
+        .queue = device->compute_queue,
+        .command_buffers = &frame->readback_command_buffer,
+        .command_buffer_count = 1,
+        .waits = {frame->readback_free},
+        .wait_stages = {VK_PIPELINE_STAGE_TRANSFER_BIT},
+        .wait_count = 1,
+    };
+
+    /* On the compute queue the barrier in the frame end already orders the copy. */
+    if (device->async_transfer) {
+        desc.lane = JOB_LANE_TRANSFER;
+        desc.queue = device->transfer_queue;
+        desc.waits[1] = last_pass_done;
+        desc.wait_stages[1] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        desc.wait_count = 2;
+    }
+
+    if (!submit_job(&renderer->jobs, &desc, &frame->readback_done)) {
+        fprintf(stderr, "submit_job() failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool begin_frame(Renderer *renderer, uint32_t tile_x, uint32_t tile_y, const Camera *camera) {
+    assert(renderer);
+    assert(camera);
+    assert(renderer->pipeline);
+    assert(!renderer->frame || renderer->submitted_passes == renderer->info.passes);
+    assert(tile_x < renderer->info.output_width && tile_y < renderer->info.output_height);
+
+    if (!renderer->info.rerecord_passes && !renderer->recorded) {
+        if (!record_command_buffers(renderer)) {
+            fprintf(stderr, "record_command_buffers() failed\n");
+            return false;
+        }
+
+        renderer->recorded = true;
+    }
+
+    uint32_t frame_index = renderer->frame_count;
+    Renderer_Frame *frame = &renderer->frames[frame_index % RENDERER_FRAMES_IN_FLIGHT];
+
+    /* The slot's command buffers must not be pending when they are submitted again. Whether the
+     * host is done with the readback buffer is left to the GPU through `released`.
+     */
+    if (!wait_for_job(&renderer->jobs, frame->readback_done)) {
+        fprintf(stderr, "wait_for_job() failed\n");
+        return false;
+    }
+
+    frame->frame_index = frame_index;
+    frame->tile_x = tile_x;
+    frame->tile_y = tile_y;
+    frame->camera = *camera;
+    frame->readback_free = frame->released;
+    frame->released = begin_host_job(&renderer->jobs);
+
+    renderer->frame = frame;
+    renderer->frame_count++;
+    renderer->submitted_passes = 0;
+    return true;
+}
+/* Submits the band of rows from `slice_y` of the current pass, as high as the slice height
+ * allows once the slot's previous slice has been measured. Returns the rows it covered.
+ */
+static bool submit_slice(Renderer *renderer, uint32_t slice_y, uint32_t *out_rows) {
+    const Device *device = renderer->device;
+    const Renderer_Info *info = &renderer->info;
+    Renderer_Frame *frame = renderer->frame;
+    uint32_t pass = renderer->submitted_passes;
+    uint32_t slot = renderer->total_slices % RENDERER_MAX_SUBMITS_IN_FLIGHT;
+
+    /* The slot's command buffer and parameters are reused, so its last slice must be done. */
+    Renderer_Submit *submit = &renderer->submits[slot];
+    if (!wait_for_job(&renderer->jobs, submit->done)) {
+        fprintf(stderr, "wait_for_job() failed\n");
+        return false;
+    }
+
+    /* Time spent waiting for the slot is not host work, so it is left out. */
+    uint64_t start_ns = timer_now_ns();
+
+    if (submit->timed && !measure_slice(renderer, slot)) {
+        fprintf(stderr, "measure_slice() failed\n");
+        return false;
+    }
+
+    uint32_t rows = info->height - slice_y;
+    if (rows > renderer->slice_height) {
+        rows = renderer->slice_height;
+    }
+
+    bool first_slice = pass == 0 && slice_y == 0;
+    bool last_slice = slice_y + rows == info->height;
+    bool frame_end = last_slice && pass + 1 == info->passes;
+
+    const Pass_Params pass_params = get_pass_params(renderer, pass, slice_y);
+    if (!write_slice_params(renderer, slot, &pass_params, rows)) {
+        return false;
+    }
+
+    if (info->rerecord_passes) {
+        const VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if ((first_slice && !record_frame_start_commands(renderer, frame, flags)) ||
+            !record_pass_commands(renderer, slot, &pass_params, flags) ||
+            (frame_end && !record_frame_end_commands(renderer, frame, flags))) {
+            return false;
+        }
+    }
+
+    VkCommandBuffer command_buffers[3];
+    uint32_t command_buffer_count = 0;
+    if (first_slice) {
+        command_buffers[command_buffer_count++] = frame->start_command_buffer;
+    }
+
+    command_buffers[command_buffer_count++] = submit->command_buffer;
+    if (frame_end) {
+        command_buffers[command_buffer_count++] = frame->end_command_buffer;
+    }
+
+    Job_Desc desc = {
+        .lane = JOB_LANE_COMPUTE,
+        .queue = device->compute_queue,
+        .command_buffers = command_buffers,
+        .command_buffer_count = command_buffer_count,
+    };
+
+    if (frame_end && info->zero_copy) {
+        /* The host may still be reading the frame that last used the packed buffer. */
+        desc.waits[0] = frame->readback_free;
+        desc.wait_stages[0] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        desc.wait_count = 1;
+    }
+
+    if (!submit_job(&renderer->jobs, &desc, &submit->done)) {
+        fprintf(stderr, "submit_job() failed\n");
+        return false;
+    }
+
+    submit->slice_rows = rows;
+    submit->timed = renderer->timestamp_pool != VK_NULL_HANDLE;
+    renderer->total_slices++;
+
+    if (frame_end && info->zero_copy) {
+        frame->readback_done = submit->done;
+    } else if (frame_end && !submit_readback(renderer, submit->done)) {
+        fprintf(stderr, "submit_readback() failed\n");
+        return false;
+    }
+
+    renderer->submit_cpu_ns += timer_now_ns() - start_ns;
+    *out_rows = rows;
+    return true;
+}
+
+bool submit_pass(Renderer *renderer) {
+    assert(renderer);
+    assert(renderer->frame);
+    assert(renderer->submitted_passes < renderer->info.passes);
+
+    for (uint32_t slice_y = 0; slice_y < renderer->info.height;) {
+        uint32_t rows;
+        if (!submit_slice(renderer, slice_y, &rows)) {
+            fprintf(stderr, "submit_slice() failed\n");
+            return false;
+        }
+
+        slice_y += rows;
+    }
+
+    renderer->submitted_passes++;
+    return true;
+}
+
+bool submit_preview(Renderer *renderer) {
+    assert(renderer);
+    assert(renderer->info.preview_scale);
+    assert(renderer->frame && renderer->submitted_passes > 0);
+    assert(!renderer->preview_pending);
+
+    if (renderer->info.rerecord_passes &&
+        !record_preview_commands(renderer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
+        return false;
+    }
+
+    /* Submission order on the compute queue places it after the passes so far. */
+    const Job_Desc desc = {
+        .lane = JOB_LANE_COMPUTE,
+        .queue = renderer->device->compute_queue,
+        .command_buffers = &renderer->preview_command_buffer,
+        .command_buffer_count = 1,
+    };
+
+    if (!submit_job(&renderer->jobs, &desc, &renderer->preview_done)) {
+        fprintf(stderr, "submit_job() failed\n");
+        return false;
+    }
+
+    renderer->preview_pending = true;
+    renderer->preview_count++;
+    return true;
+}
+
+const void *wait_for_preview(Renderer *renderer) {
+    assert(renderer);
+    assert(renderer->preview_pending);
+
+    if (!wait_for_job(&renderer->jobs, renderer->preview_done)) {
+        fprintf(stderr, "wait_for_job() failed\n");
+        return NULL;
+    }
+
+    /* A no-op on host-coherent memory. */
+    VkResult result = vmaInvalidateAllocation(renderer->allocator, renderer->preview_allocation,
+                                              0, VK_WHOLE_SIZE);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaInvalidateAllocation() failed: %s\n", string_VkResult(result));
+        return NULL;
+    }
+
+    renderer->preview_pending = false;
+    return renderer->preview_allocation_info.pMappedData;
+}
+
+static const Renderer_Frame *find_frame(const Renderer *renderer, uint32_t frame_index) {
+    const Renderer_Frame *frame = &renderer->frames[frame_index % RENDERER_FRAMES_IN_FLIGHT];
+    assert(frame_index < renderer->frame_count);
+    assert(frame->frame_index == frame_index);
+    return frame;
+}
+
+bool wait_for_frame(Renderer *renderer, uint32_t frame_index) {
+    assert(renderer);
+
+    const Renderer_Frame *frame = find_frame(renderer, frame_index);
+    assert(frame != renderer->frame || renderer->submitted_passes == renderer->info.passes);
+
+    if (!wait_for_job(&renderer->jobs, frame->readback_done)) {
+        fprintf(stderr, "wait_for_job() failed\n");
+        return false;
+    }
+
+    /* A no-op on host-coherent memory. */
+    VmaAllocation allocation =
+        renderer->info.zero_copy ? frame->packed_allocation : frame->readback_allocation;
+    VkResult result = vmaInvalidateAllocation(renderer->allocator, allocation, 0, VK_WHOLE_SIZE);
+
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vmaInvalidateAllocation() failed: %s\n", string_VkResult(result));
+        return false;
+    }
+
+    return true;
+}
+
+const void *get_frame_pixels(const Renderer *renderer, uint32_t frame_index) {
+    const Renderer_Frame *frame = find_frame(renderer, frame_index);
+    if (renderer->info.zero_copy) {
+        return frame->packed_allocation_info.pMappedData;
+    }
+
+    return frame->readback_allocation_info.pMappedData;
+}
+
+bool release_frame(Renderer *renderer, uint32_t frame_index) {
+    assert(renderer);
+
+    const Renderer_Frame *frame = find_frame(renderer, frame_index);
+    if (!complete_host_job(&renderer->jobs, frame->released)) {
+        fprintf(stderr, "complete_host_job() failed\n");
+        return false;
+    }
+
+    return true;
+}
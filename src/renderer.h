@@ -0,0 +1,309 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "bindless.h"
+#include "camera.h"
+#include "device.h"
+#include "job_graph.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "readback.h"
+
+typedef struct Renderer_Info {
+    /* Must match the workgroup sizes the bound pipeline was specialised with. */
+    Workgroup_Sizes workgroup_sizes;
+
+    /* Size of the image each frame renders. */
+    uint32_t width;
+    uint32_t height;
+
+    /* How frames are packed for the host. Must be `width` x `height` and match the layout of the
+     * pack pipeline.
+     */
+    Readback_Layout readback;
+
+    /* Size of the whole picture. When it is larger than `width` x `height`, each frame renders
+     * the tile of it at the origin passed to begin_frame().
+     */
+    uint32_t output_width;
+    uint32_t output_height;
+
+    /* Sample passes accumulated into each frame, each in its own submission. */
+    uint32_t passes;
+
+    /* Records every command buffer again before submitting it instead of replaying the ones
+     * recorded by the first begin_frame(), and pushes each slice's Pass_Params as push constants
+     * instead of writing them to the parameter buffer. The bound pipeline must be specialised with
+     * `push_params` to match. Only useful for measuring what replay saves.
+     */
+    bool rerecord_passes;
+
+    /* Base seed of the random sequence; renders with different seeds have independent noise. */
+    uint32_t seed;
+
+    /* GPU time each submission should take, in milliseconds. Passes are split into bands of rows
+     * sized from the timestamps of earlier bands, which keeps long passes under driver timeouts
+     * and lets other work reach the queue between them. Zero, or a compute queue without
+     * timestamps, submits every pass as a single dispatch.
+     */
+    double slice_ms;
+
+    /* Packs frames straight into persistently mapped, host-visible device memory that the host
+     * reads in place, instead of into device memory that is then copied into a readback buffer.
+     * Requires renderer_supports_zero_copy().
+     */
+    bool zero_copy;
+
+    /* Downsampling factor of previews, or zero for none. `preview` must then be the layout of the
+     * image divided by it, rounded up, and match the preview pack pipeline.
+     */
+    uint32_t preview_scale;
+    Readback_Layout preview;
+} Renderer_Info;
+
+/* Slices that may be queued before submit_pass() waits for the oldest one to finish. */
+#define RENDERER_MAX_SUBMITS_IN_FLIGHT 2
+
+/* Frames whose readback may be outstanding at once: the host encodes one while the GPU renders
+ * the next.
+ */
+#define RENDERER_FRAMES_IN_FLIGHT 2
+
+/* A pass command buffer and the slice its last submission rendered. */
+typedef struct Renderer_Submit {
+    VkCommandBuffer command_buffer;
+    Job_Point done;
+    uint32_t slice_rows;
+
+    /* Set while the slot's timestamps hold a slice that has not been measured yet. */
+    bool timed;
+} Renderer_Submit;
+
+/* The resources of one frame in flight, reused every RENDERER_FRAMES_IN_FLIGHT frames. */
+typedef struct Renderer_Frame {
+    /* Submitted on the compute queue with the first and the last pass. */
+    VkCommandBuffer start_command_buffer;
+    VkCommandBuffer end_command_buffer;
+
+    /* Copies `packed_buffer` into `readback_buffer` on the transfer queue, or on the compute
+     * queue without async transfer. `readback_done` is reached once the whole frame has
+     * completed. With zero-copy output there is no copy, buffer or command buffer, and
+     * `readback_done` is reached with the last pass.
+     */
+    VkCommandBuffer readback_command_buffer;
+    Job_Point readback_done;
+
+    /* Host job completed by release_frame() once the host no longer reads `readback_buffer`. */
+    Job_Point released;
+
+    /* `released` of the frame that used the slot before. The readback waits on it on the GPU, or
+     * with zero-copy output the last pass, whose pack overwrites what the host was reading.
+     */
+    Job_Point readback_free;
+
+    /* The frame in `info.readback` layout, written by the pack kernel. Device-local, or with
+     * zero-copy output host-visible and mapped for the lifetime of the renderer.
+     */
+    VkBuffer packed_buffer;
+    VmaAllocation packed_allocation;
+    VmaAllocationInfo packed_allocation_info;
+    VkDescriptorSet pack_descriptor_set;
+
+    VkBuffer readback_buffer;
+    VmaAllocation readback_allocation;
+    VmaAllocationInfo readback_allocation_info;
+
+    uint32_t frame_index;
+    uint32_t tile_x;
+    uint32_t tile_y;
+    Camera camera;
+} Renderer_Frame;
+
+/* Per-job GPU state: the accumulation image, a ring of packed and host-visible readback buffers
+ * and the command buffers that render into one and copy to the others.
+ *
+ * A frame is rendered progressively: every pass adds one sample per pixel to a float
+ * accumulation image, and after the last pass the pack kernel converts the average into the
+ * frame's packed buffer in `info.readback` layout, which is all that is copied back. Passes are
+ * separate submissions, each tracked by its own fence, so the host can follow progress without
+ * idling the queue. With `info.slice_ms`, each pass is further split into bands of rows
+ * submitted one after another, with the band height adapted to the GPU time the previous bands
+ * took.
+ *
+ * Each frame is packed and copied into its own buffers, so the next frame can be submitted and
+ * rendered while the host is still reading the previous one.
+ *
+ * On devices with cached host-visible device memory, `info.zero_copy` drops the copy: the pack
+ * kernel writes each frame into a mapped buffer the host reads in place.
+ *
+ * Output larger than one image is rendered as a sequence of frames, one per tile, that all reuse
+ * the same tile-sized image and buffers. GPU memory use then depends on the tile size alone, not
+ * on the size of the output.
+ *
+ * Submissions are ordered through a Job_Graph. With an async transfer queue, the dispatches run
+ * on the compute queue and the readback copy on the transfer queue, which waits on the last pass.
+ * The packed buffer is released by the compute family and acquired by the transfer family around
+ * the copy.
+ */
+typedef struct Renderer {
+    const Device *device;
+    VmaAllocator allocator;
+    Renderer_Info info;
+
+    /* NULL until bind_renderer_pipeline(). */
+    const Pathtracing_Pipeline *pipeline;
+    const Pack_Pipeline *pack_pipeline;
+    const Pack_Pipeline *preview_pipeline;
+
+    /* The KERNEL_PATHTRACE variant dispatched: get_kernel() of `pipeline` unless
+     * set_renderer_kernel() picked another.
+     */
+    VkPipeline kernel;
+
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+
+    /* The scene's buffers, images and samplers, bound as set 1 of every dispatch. Created by
+     * bind_renderer_pipeline() in the pipeline's scene layout; add resources with
+     * add_bindless_buffer() and friends.
+     */
+    Bindless_Set scene;
+
+    VkImage accumulation_image;
+    VmaAllocation accumulation_allocation;
+    VkImageView accumulation_view;
+
+    /* Per-slice parameters and dispatch sizes, one slot of `params_stride` bytes per submission in
+     * flight.
+     */
+    VkBuffer params_buffer;
+    VmaAllocation params_allocation;
+    VmaAllocationInfo params_allocation_info;
+    VkDeviceSize params_stride;
+
+    VkCommandPool compute_command_pool;
+    Renderer_Submit submits[RENDERER_MAX_SUBMITS_IN_FLIGHT];
+    Renderer_Frame frames[RENDERER_FRAMES_IN_FLIGHT];
+    bool recorded;
+
+    /* Start and end timestamps of each submit slot, or VK_NULL_HANDLE when passes are not
+     * sliced.
+     */
+    VkQueryPool timestamp_pool;
+
+    /* Rows per slice, a multiple of the workgroup height unless it covers the whole image. */
+    uint32_t slice_height;
+
+    /* Only created when device->async_transfer is set. */
+    VkCommandPool transfer_command_pool;
+
+    /* Only with `info.preview_scale`: the latest preview, in `info.preview` layout and mapped for
+     * the lifetime of the renderer, and the command buffer that packs it on the compute queue.
+     */
+    VkBuffer preview_buffer;
+    VmaAllocation preview_allocation;
+    VmaAllocationInfo preview_allocation_info;
+    VkDescriptorSet preview_descriptor_set;
+    VkCommandBuffer preview_command_buffer;
+    Job_Point preview_done;
+    bool preview_pending;
+    uint32_t preview_count;
+
+    Job_Graph jobs;
+
+    /* The frame being submitted, NULL before the first begin_frame(). */
+    Renderer_Frame *frame;
+    uint32_t frame_count;
+    uint32_t submitted_passes;
+
+    /* Slices submitted over all frames, which picks the submit slot. */
+    uint32_t total_slices;
+
+    /* Host time spent in submit_pass() over all frames, excluding fence waits. */
+    uint64_t submit_cpu_ns;
+
+    /* GPU time of the slices measured so far, and the image rows they covered. */
+    uint32_t timed_slices;
+    uint64_t timed_rows;
+    double slice_gpu_ms;
+} Renderer;
+
+/* Whether the device has memory that is device-local, host-visible and host-cached, which the GPU
+ * can write at full speed and the host can read without a copy.
+ */
+bool renderer_supports_zero_copy(const Device *device);
+
+/* Creates the renderer's resources. Each group is recorded as a phase in `profile`. Nothing here
+ * depends on the pipeline, so this can run while the pipeline is still compiling.
+ */
+bool create_renderer(const Device *device, VmaAllocator allocator, const Renderer_Info *info,
+                     Profile *profile, Renderer *renderer);
+
+/* Allocates the descriptor sets for `pipeline`, `pack_pipeline` and `preview_pipeline` and points
+ * them at the accumulation target and the packed and preview buffers, and creates the empty scene
+ * set. `preview_pipeline` is only used, and may only be NULL, without `info.preview_scale`. Must
+ * be called once before the first begin_frame().
+ */
+bool bind_renderer_pipeline(Renderer *renderer, const Pathtracing_Pipeline *pipeline,
+                            const Pack_Pipeline *pack_pipeline,
+                            const Pack_Pipeline *preview_pipeline);
+
+/* Dispatches `kernel`, a KERNEL_PATHTRACE variant from get_kernel_variant() on the bound
+ * pipeline, instead of the one the pipeline compiled up front. Its workgroup sizes must be
+ * `info.workgroup_sizes`. Replayed passes are recorded by the first begin_frame(), so without
+ * `info.rerecord_passes` this must come before it.
+ */
+void set_renderer_kernel(Renderer *renderer, VkPipeline kernel);
+
+/* Every submitted frame must have completed, for example through wait_for_frame(). */
+void destroy_renderer(Renderer *renderer);
+
+/* Starts frame `frame_count` in the next slot of the ring, first waiting for the GPU work of the
+ * frame that last used it. The frame renders the tile of the output whose top-left pixel is at
+ * (`tile_x`, `tile_y`); (0, 0) when the output is a single tile, as seen from `camera`. The
+ * frame's readback waits on the GPU until that frame is released. The first call also records
+ * the command buffers replayed by every frame; a new camera only changes the parameters written
+ * per slice.
+ */
+bool begin_frame(Renderer *renderer, uint32_t tile_x, uint32_t tile_y, const Camera *camera);
+
+/* Submits the next of `info.passes` passes as one or more slices, first waiting for the
+ * submission that last used each slice's command buffer and parameter slot. The last pass also
+ * queues the readback.
+ *
+ * Without timeline semaphores the readback is submitted only once the frame that last used the
+ * slot has been released, so release frames before submitting the last pass of the frame
+ * RENDERER_FRAMES_IN_FLIGHT later.
+ */
+bool submit_pass(Renderer *renderer);
+
+/* Queues a preview of the current frame as the passes submitted so far leave it: the
+ * accumulation image downsampled by `info.preview_scale` on the GPU, so only a thumbnail is
+ * read back. Requires `info.preview_scale`, and the previous preview must have been waited for.
+ */
+bool submit_preview(Renderer *renderer);
+
+/* Blocks until the preview queued by submit_preview() is done and returns its pixels in
+ * `info.preview` layout, or NULL on failure. Valid until the next submit_preview().
+ */
+const void *wait_for_preview(Renderer *renderer);
+
+/* Blocks until frame `frame_index`, one of the last RENDERER_FRAMES_IN_FLIGHT frames begun, has
+ * been copied back.
+ */
+bool wait_for_frame(Renderer *renderer, uint32_t frame_index);
+
+/* Pixels of a frame that wait_for_frame() returned for, in `info.readback` layout. Tiles at the
+ * right and bottom edges of the output are only partly valid. Valid until release_frame().
+ */
+const void *get_frame_pixels(const Renderer *renderer, uint32_t frame_index);
+
+/* Hands the frame's readback buffer back to the GPU. Frames must be released in order. */
+bool release_frame(Renderer *renderer, uint32_t frame_index);
+
+#endif /* RENDERER_H */
@@ -0,0 +1,126 @@
+#include "sequence.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+
+/* Longer lines are rejected rather than split. */
+#define SEQUENCE_MAX_LINE 512
+
+/* Parses the seven numbers of a frame line into `camera`. */
+static bool parse_camera(const char *line, Camera *camera) {
+    float *fields[] = {
+        &camera->position[0], &camera->position[1], &camera->position[2], &camera->target[0],
+        &camera->target[1],   &camera->target[2],   &camera->fov_degrees,
+    };
+
+    const char *cursor = line;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        char *end;
+        errno = 0;
+        *fields[i] = strtof(cursor, &end);
+        if (errno != 0 || end == cursor) {
+            return false;
+        }
+
+        cursor = end;
+    }
+
+    while (isspace((unsigned char)*cursor)) {
+        cursor++;
+    }
+
+    return *cursor == '\0' && camera->fov_degrees > 0.0f && camera->fov_degrees < 180.0f;
+}
+
+/* Appends a camera for every frame line of `file` to `sequence`. */
+static bool read_cameras(FILE *file, const char *path, Sequence *sequence) {
+    uint32_t capacity = 0;
+    uint32_t line_number = 0;
+    char line[SEQUENCE_MAX_LINE];
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        size_t length = strlen(line);
+        if (length + 1 == sizeof(line) && line[length - 1] != '\n') {
+            fprintf(stderr, "%s:%u: line too long\n", path, line_number);
+            return false;
+        }
+
+        const char *start = line;
+        while (isspace((unsigned char)*start)) {
+            start++;
+        }
+
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+
+        if (sequence->frame_count == capacity) {
+            uint32_t new_capacity = capacity ? 2 * capacity : 64;
+            Camera *cameras = realloc(sequence->cameras, new_capacity * sizeof(Camera));
+            if (!cameras) {
+                fprintf(stderr, "Failed to allocate %u cameras\n", new_capacity);
+                return false;
+            }
+
+            sequence->cameras = cameras;
+            capacity = new_capacity;
+        }
+
+        if (!parse_camera(start, &sequence->cameras[sequence->frame_count])) {
+            fprintf(stderr, "%s:%u: expected position, target and field of view\n", path,
+                    line_number);
+            return false;
+        }
+
+        sequence->frame_count++;
+    }
+
+    if (ferror(file)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool load_sequence(const char *path, Sequence *sequence) {
+    assert(path);
+    assert(sequence);
+
+    *sequence = (Sequence){0};
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    bool read = read_cameras(file, path, sequence);
+    fclose(file);
+
+    if (read && sequence->frame_count == 0) {
+        fprintf(stderr, "%s: no frames\n", path);
+        read = false;
+    }
+
+    if (!read) {
+        destroy_sequence(sequence);
+        return false;
+    }
+
+    return true;
+}
+
+void destroy_sequence(Sequence *sequence) {
+    free(sequence->cameras);
+    *sequence = (Sequence){0};
+}
@@ -0,0 +1,26 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "camera.h"
+
+/* The cameras of a sequence of frames rendered back to back in one process. */
+typedef struct Sequence {
+    Camera *cameras;
+    uint32_t frame_count;
+} Sequence;
+
+/* Reads a sequence file: one frame per line, given as seven numbers separated by whitespace,
+ *
+ *     position_x position_y position_z target_x target_y target_z fov_degrees
+ *
+ * Blank lines and lines starting with '#' are skipped. Fails on a malformed line or a file
+ * without frames.
+ */
+bool load_sequence(const char *path, Sequence *sequence);
+
+void destroy_sequence(Sequence *sequence);
+
+#endif /* SEQUENCE_H */
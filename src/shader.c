@@ -0,0 +1,178 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "shader.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vk_enum_string_helper.h>
+#include <vulkan/vulkan.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef struct Mapped_File {
+    const void *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} Mapped_File;
+
+static bool map_file(const char *path, Mapped_File *out_file) {
+    *out_file = (Mapped_File){0};
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "%s: CreateFileA() failed: %lu\n", path, GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        fprintf(stderr, "%s: empty or unreadable file\n", path);
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        fprintf(stderr, "%s: CreateFileMappingA() failed: %lu\n", path, GetLastError());
+        CloseHandle(file);
+        return false;
+    }
+
+    const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        fprintf(stderr, "%s: MapViewOfFile() failed: %lu\n", path, GetLastError());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    *out_file = (Mapped_File){
+        .data = data,
+        .size = (size_t)file_size.QuadPart,
+        .file = file,
+        .mapping = mapping,
+    };
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable file\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping stays valid after the descriptor is closed. */
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        perror("mmap failed");
+        return false;
+    }
+
+    *out_file = (Mapped_File){
+        .data = data,
+        .size = (size_t)st.st_size,
+    };
+#endif
+
+    return true;
+}
+
+static void unmap_file(Mapped_File *file) {
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+    CloseHandle(file->file);
+#else
+    munmap((void *)file->data, file->size);
+#endif
+}
+
+static VkShaderModule create_module_from_code(VkDevice device,
+                                              const VkAllocationCallbacks *allocation_callbacks,
+                                              const uint32_t *code, size_t size) {
+    if (size == 0 || size % sizeof(uint32_t) != 0) {
+        fprintf(stderr, "SPIR-V size is not a multiple of 4: %zu bytes\n", size);
+        return VK_NULL_HANDLE;
+    }
+
+    const VkShaderModuleCreateInfo shader_module_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pCode = code,
+        .codeSize = size,
+    };
+
+    VkShaderModule shader_module;
+    VkResult result =
+        vkCreateShaderModule(device, &shader_module_info, allocation_callbacks, &shader_module);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "vkCreateShaderModule failed: %s\n", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    return shader_module;
+}
+
+VkShaderModule create_shader_module(VkDevice device,
+                                    const VkAllocationCallbacks *allocation_callbacks,
+                                    const Shader_Source *source, const char *override_dir) {
+    assert(device);
+    assert(source);
+
+    if (!override_dir) {
+        return create_module_from_code(device, allocation_callbacks, source->code, source->size);
+    }
+
+    size_t dir_len = strlen(override_dir);
+    size_t name_len = strlen(source->name);
+    char *path = malloc(dir_len + 1 + name_len + 1);
+    if (!path) {
+        perror("malloc failed");
+        return VK_NULL_HANDLE;
+    }
+
+    memcpy(path, override_dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, source->name, name_len + 1);
+
+    Mapped_File file;
+    if (!map_file(path, &file)) {
+        fprintf(stderr, "map_file() failed\n");
+        free(path);
+        return VK_NULL_HANDLE;
+    }
+
+    free(path);
+
+    VkShaderModule shader_module =
+        create_module_from_code(device, allocation_callbacks, file.data, file.size);
+    unmap_file(&file);
+    return shader_module;
+}
@@ -0,0 +1,25 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+typedef struct Shader_Source {
+    /* File name of the compiled shader, used to locate it in an override directory. */
+    const char *name;
+
+    /* Embedded SPIR-V; `size` is in bytes. */
+    const uint32_t *code;
+    size_t size;
+} Shader_Source;
+
+/* Creates a shader module from the SPIR-V embedded in the executable. If `override_dir` is not
+ * NULL, `<override_dir>/<source->name>` is memory-mapped and used instead, which lets shaders be
+ * iterated on without relinking. `allocation_callbacks` may be NULL.
+ */
+VkShaderModule create_shader_module(VkDevice device,
+                                    const VkAllocationCallbacks *allocation_callbacks,
+                                    const Shader_Source *source, const char *override_dir);
+
+#endif /* SHADER_H */
@@ -0,0 +1,21 @@
+#ifndef SHADERS_H
+#define SHADERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SPIR-V generated from shaders/ by the Shaders target (see cmake/embed_spirv.cmake). Sizes are in
+ * bytes.
+ */
+
+extern const uint32_t pathtracer_comp_spv[];
+extern const size_t pathtracer_comp_spv_size;
+
+/* pathtracer.comp built with BINDLESS, for devices with descriptor indexing. */
+extern const uint32_t pathtracer_bindless_comp_spv[];
+extern const size_t pathtracer_bindless_comp_spv_size;
+
+extern const uint32_t pack_comp_spv[];
+extern const size_t pack_comp_spv_size;
+
+#endif /* SHADERS_H */
@@ -0,0 +1,42 @@
+#include "specialization.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+void init_specialization(const Specialization_Constant *table, uint32_t count, const void *data,
+                         size_t size, Specialization *specialization) {
+    assert(table);
+    assert(count <= SPECIALIZATION_MAX_CONSTANTS);
+    assert(data);
+    assert(specialization);
+
+    for (uint32_t i = 0; i < count; i++) {
+        assert(table[i].offset + sizeof(uint32_t) <= size);
+
+        specialization->entries[i] = (VkSpecializationMapEntry){
+            .constantID = table[i].id,
+            .offset = table[i].offset,
+            .size = sizeof(uint32_t),
+        };
+    }
+
+    specialization->info = (VkSpecializationInfo){
+        .pMapEntries = specialization->entries,
+        .mapEntryCount = count,
+        .dataSize = size,
+        .pData = data,
+    };
+}
+
+uint64_t hash_specialization(const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
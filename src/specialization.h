@@ -0,0 +1,39 @@
+#ifndef SPECIALIZATION_H
+#define SPECIALIZATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* Most constants one kernel is specialised with. */
+#define SPECIALIZATION_MAX_CONSTANTS 16
+
+/* A 32-bit specialization constant: its constant_id in the kernel and the offset of its value in
+ * the struct that holds the kernel's constants. Each kernel describes its constants with a static
+ * table of these, so adding one is a field, a table row and a constant_id in the shader.
+ */
+typedef struct Specialization_Constant {
+    uint32_t id;
+    uint32_t offset;
+} Specialization_Constant;
+
+/* The VkSpecializationInfo for one set of values. `info` points into `entries`, so the struct must
+ * not be copied once initialised.
+ */
+typedef struct Specialization {
+    VkSpecializationMapEntry entries[SPECIALIZATION_MAX_CONSTANTS];
+    VkSpecializationInfo info;
+} Specialization;
+
+/* Maps the `count` constants of `table` onto the `size` bytes at `data`, which must outlive
+ * `specialization`.
+ */
+void init_specialization(const Specialization_Constant *table, uint32_t count, const void *data,
+                         size_t size, Specialization *specialization);
+
+/* 64-bit FNV-1a of a constants struct, used to key compiled variants. The struct must have no
+ * padding, so equal values always hash the same.
+ */
+uint64_t hash_specialization(const void *data, size_t size);
+
+#endif /* SPECIALIZATION_H */
@@ -0,0 +1,118 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "task.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "timer.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+static void run_task(Task *task) {
+    task->start_ns = timer_now_ns();
+    task->result = task->func(task->arg);
+    task->end_ns = timer_now_ns();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI task_entry(LPVOID arg) {
+    run_task(arg);
+    return 0;
+}
+#else
+static void *task_entry(void *arg) {
+    run_task(arg);
+    return NULL;
+}
+#endif
+
+void task_start(Task *task, const char *name, Task_Func func, void *arg, bool threaded) {
+    assert(task);
+    assert(func);
+
+    *task = (Task){
+        .name = name,
+        .func = func,
+        .arg = arg,
+    };
+
+    if (threaded) {
+#ifdef _WIN32
+        task->thread = CreateThread(NULL, 0, task_entry, task, 0, NULL);
+        task->threaded = task->thread != NULL;
+        if (!task->threaded) {
+            fprintf(stderr, "Warning: CreateThread() failed for task %s: %lu\n", name,
+                    GetLastError());
+        }
+#else
+        int error = pthread_create(&task->thread, NULL, task_entry, task);
+        task->threaded = error == 0;
+        if (error) {
+            fprintf(stderr, "Warning: pthread_create() failed for task %s: %s\n", name,
+                    strerror(error));
+        }
+#endif
+    }
+
+    if (!task->threaded) {
+        run_task(task);
+    }
+}
+
+bool task_wait(Task *task) {
+    assert(task);
+
+    if (task->threaded) {
+#ifdef _WIN32
+        WaitForSingleObject(task->thread, INFINITE);
+        CloseHandle(task->thread);
+#else
+        pthread_join(task->thread, NULL);
+#endif
+        task->threaded = false;
+    }
+
+    return task->result;
+}
+
+void mutex_init(Mutex *mutex) {
+#ifdef _WIN32
+    InitializeSRWLock((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_init(&mutex->lock, NULL);
+#endif
+}
+
+void mutex_destroy(Mutex *mutex) {
+#ifdef _WIN32
+    (void)mutex;
+#else
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+}
+
+void mutex_lock(Mutex *mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void mutex_unlock(Mutex *mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
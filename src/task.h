@@ -0,0 +1,60 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef bool (*Task_Func)(void *arg);
+
+/* A unit of start-up work that runs on its own worker thread. Tasks must only share state that is
+ * safe to use concurrently; in particular a Profile is not, so each task keeps its own and the
+ * waiting thread merges it with profile_merge().
+ */
+typedef struct Task {
+    const char *name;
+    Task_Func func;
+    void *arg;
+
+    bool result;
+    bool threaded;
+
+    /* When `func` started and returned on the thread that ran it, for reporting how long the
+     * task took apart from how long the waiting thread blocked on it.
+     */
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+#ifdef _WIN32
+    void *thread;
+#else
+    pthread_t thread;
+#endif
+} Task;
+
+/* A plain non-recursive mutex. On Windows this is an SRWLOCK, which is pointer-sized. */
+typedef struct Mutex {
+#ifdef _WIN32
+    void *lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} Mutex;
+
+void mutex_init(Mutex *mutex);
+void mutex_destroy(Mutex *mutex);
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+
+/* Starts `func(arg)` on a new thread. If `threaded` is false, or the thread cannot be created, the
+ * task runs to completion on the calling thread before this returns.
+ */
+void task_start(Task *task, const char *name, Task_Func func, void *arg, bool threaded);
+
+/* Waits for the task to finish and returns the value `func` returned. */
+bool task_wait(Task *task);
+
+#endif /* TASK_H */
@@ -0,0 +1,84 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Offsets into images over 2 GiB need a 64-bit off_t on 32-bit platforms. */
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "tile_writer.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+static bool seek_to(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+bool open_tile_writer(const char *path, uint32_t width, uint32_t height, Tile_Writer *writer) {
+    assert(path);
+    assert(width > 0 && height > 0);
+    assert(writer);
+
+    *writer = (Tile_Writer){
+        .path = path,
+        .width = width,
+        .height = height,
+    };
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    int header_size = fprintf(writer->file, "P6\n%u %u\n255\n", width, height);
+    if (header_size < 0) {
+        fprintf(stderr, "Failed to write the header of %s\n", path);
+        fclose(writer->file);
+        return false;
+    }
+
+    writer->header_size = (uint64_t)header_size;
+    return true;
+}
+
+bool write_tile(Tile_Writer *writer, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                const uint8_t *pixels, size_t row_pitch) {
+    assert(writer);
+    assert(pixels);
+    assert(x + width <= writer->width && y + height <= writer->height);
+
+    for (uint32_t row = 0; row < height; row++) {
+        /* Seeking past the end is fine; rows of tiles not written yet are zero-filled. */
+        uint64_t offset = writer->header_size + 3 * ((uint64_t)(y + row) * writer->width + x);
+        if (!seek_to(writer->file, offset) ||
+            fwrite(pixels + row * row_pitch, 3, width, writer->file) != width) {
+            fprintf(stderr, "Failed to write a tile to %s\n", writer->path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool close_tile_writer(Tile_Writer *writer) {
+    assert(writer);
+
+    bool closed = fclose(writer->file) == 0;
+    if (!closed) {
+        fprintf(stderr, "Failed to close %s\n", writer->path);
+    }
+
+    *writer = (Tile_Writer){0};
+    return closed;
+}
@@ -0,0 +1,33 @@
+#ifndef TILE_WRITER_H
+#define TILE_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Writes an image as a binary PPM one tile at a time, in any order. Every row of a tile is written
+ * straight to its place in the file from the readback buffer, so images far larger than memory can
+ * be written.
+ */
+typedef struct Tile_Writer {
+    FILE *file;
+    const char *path;
+    uint32_t width;
+    uint32_t height;
+    uint64_t header_size;
+} Tile_Writer;
+
+/* Creates `path` for a `width` x `height` image. `path` must outlive the writer. */
+bool open_tile_writer(const char *path, uint32_t width, uint32_t height, Tile_Writer *writer);
+
+/* Writes the `width` x `height` RGB8 tile at (x, y), whose rows are `row_pitch` bytes apart. The
+ * tile must lie within the image.
+ */
+bool write_tile(Tile_Writer *writer, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                const uint8_t *pixels, size_t row_pitch);
+
+/* Closes the file, returning false if buffered data could not be written. */
+bool close_tile_writer(Tile_Writer *writer);
+
+#endif /* TILE_WRITER_H */
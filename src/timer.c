@@ -0,0 +1,36 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "timer.h"
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+uint64_t timer_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    /* Split the conversion to avoid overflowing 64 bits on long uptimes. */
+    uint64_t seconds = (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart;
+    uint64_t remainder = (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart;
+    return seconds * 1000000000ull + remainder * 1000000000ull / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+double timer_ms_between(uint64_t start_ns, uint64_t end_ns) {
+    return (double)(end_ns - start_ns) / 1.0e6;
+}
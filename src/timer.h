@@ -0,0 +1,13 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/* Returns a monotonic timestamp in nanoseconds. Only differences between two timestamps are
+ * meaningful.
+ */
+uint64_t timer_now_ns(void);
+
+double timer_ms_between(uint64_t start_ns, uint64_t end_ns);
+
+#endif /* TIMER_H */